@@ -0,0 +1,666 @@
+#include "BuildOrderSearch.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace
+{
+    // frames of income at the rate until what we have covers the cost, never if there is none
+    int FramesToAfford(double have, double rate, int never, int cost)
+    {
+        if (have >= cost) { return 0; }
+        if (rate <= 0) { return never; }
+        return (int)std::ceil((cost - have) / rate);
+    }
+}
+
+BuildOrderSearch::BuildOrderSearch()
+    : m_table(new std::atomic<uint64_t>[size_t(1) << TableBits])
+{
+
+}
+
+int BuildOrderSearch::actionOf(BWAPI::UnitType type) const
+{
+    for (size_t a = 0; a < m_actions.size(); ++a)
+    {
+        if (m_actions[a].type == type) { return (int)a; }
+    }
+    return -1;
+}
+
+// Adds the type along with whatever trains it and its requirements; -1 if it can't be planned.
+// Add-ons and units that need research are left to the script.
+int BuildOrderSearch::addAction(BWAPI::UnitType type)
+{
+    const int existing = actionOf(type);
+    if (existing >= 0) { return existing; }
+
+    if (type.getRace() != BWAPI::Races::Terran || type.isAddon() || type.requiredTech() != BWAPI::TechTypes::None) { return -1; }
+    if (m_actions.size() == MaxActions) { return -1; }
+
+    Action action;
+    action.type           = type;
+    action.minerals       = type.mineralPrice();
+    action.gas            = type.gasPrice();
+    action.buildTime      = type.buildTime();
+    action.supplyRequired = type.supplyRequired();
+    action.supplyProvided = type.supplyProvided();
+    action.refinery       = type.isRefinery();
+    action.worker         = type.isWorker();
+
+    // recursion below grows m_actions, so the action is only referred to by index from here on
+    const int a = (int)m_actions.size();
+    m_actions.push_back(action);
+
+    const BWAPI::UnitType builderType = type.whatBuilds().first;
+    if (!builderType.isWorker())
+    {
+        const int builder = addAction(builderType);
+        if (builder < 0) { return -1; }
+
+        m_actions[a].builder = builder;
+        m_actions[builder].producer = true;
+    }
+
+    for (auto & [requiredType, count] : type.requiredUnits())
+    {
+        if (requiredType.isWorker() || requiredType == builderType) { continue; }
+
+        const int r = addAction(requiredType);
+        if (r < 0) { return -1; }
+
+        m_actions[a].required |= 1u << r;
+    }
+
+    return a;
+}
+
+bool BuildOrderSearch::buildActions(const BuildScript::Goal & goal)
+{
+    m_actions.clear();
+    m_goal.fill(0);
+
+    for (auto & [type, count] : goal)
+    {
+        const int a = addAction(type);
+        if (a < 0) { return false; }
+
+        m_goal[a] += count;
+    }
+
+    m_workerAction = addAction(BWAPI::UnitTypes::Terran_SCV);
+    m_supplyAction = addAction(BWAPI::UnitTypes::Terran_Supply_Depot);
+    m_refineryAction = -1;
+
+    const bool needsGas = std::any_of(m_actions.begin(), m_actions.end(), [](const Action & action) { return action.gas > 0; });
+    if (needsGas)
+    {
+        m_refineryAction = addAction(BWAPI::UnitTypes::Terran_Refinery);
+        if (m_refineryAction < 0) { return false; }
+    }
+
+    return m_workerAction >= 0 && m_supplyAction >= 0;
+}
+
+// Our units as the search sees them: finished ones, buildings under construction as jobs, and
+// whatever the production buildings are training as jobs that keep them busy.
+BuildOrderSearch::State BuildOrderSearch::snapshot(int minerals, int gas) const
+{
+    const BWAPI::Player self = BWAPI::Broodwar->self();
+
+    State s;
+    s.frame      = BWAPI::Broodwar->getFrameCount();
+    s.minerals   = std::max(0, minerals);
+    s.gas        = std::max(0, gas);
+    s.supplyUsed = self->supplyUsed();
+    s.supplyMax  = self->supplyTotal();
+
+    for (auto & unit : self->getUnits())
+    {
+        const BWAPI::UnitType type = unit->getType();
+        const int a = actionOf(type);
+
+        // units being trained are counted from their producer's queue
+        if (!unit->isCompleted())
+        {
+            if (a < 0 || !type.isBuilding() || s.jobCount == MaxJobs) { continue; }
+
+            s.jobs[s.jobCount++] = { s.frame + unit->getRemainingBuildTime(), (int8_t)a, false };
+            s.started[a]++;
+            s.supplyPending += m_actions[a].supplyProvided;
+            continue;
+        }
+
+        if (type.isWorker())
+        {
+            if (unit->isGatheringGas()) { s.gasWorkers++; }
+            else                        { s.mineralWorkers++; }
+        }
+
+        if (a < 0) { continue; }
+
+        s.completed[a]++;
+        s.started[a]++;
+
+        if (!m_actions[a].producer || s.producerCount == MaxProducers) { continue; }
+
+        int freeAt = s.frame;
+        if (unit->isTraining() && !unit->getTrainingQueue().empty())
+        {
+            freeAt += unit->getRemainingTrainTime();
+
+            const int trainee = actionOf(unit->getTrainingQueue().front());
+            if (trainee >= 0 && s.jobCount < MaxJobs)
+            {
+                s.jobs[s.jobCount++] = { freeAt, (int8_t)trainee, false };
+                s.started[trainee]++;
+            }
+        }
+        s.producers[s.producerCount++] = { freeAt, (int8_t)a };
+    }
+
+    return s;
+}
+
+void BuildOrderSearch::gather(State & s, int frames) const
+{
+    if (frames <= 0) { return; }
+
+    s.minerals += s.mineralWorkers * MineralsPerWorkerFrame * frames;
+    s.gas      += s.gasWorkers * GasPerWorkerFrame * frames;
+}
+
+void BuildOrderSearch::finishJob(State & s, int j) const
+{
+    const Job job = s.jobs[j];
+    s.jobs[j] = s.jobs[--s.jobCount];
+
+    const Action & action = m_actions[job.action];
+    s.completed[job.action]++;
+
+    if (action.worker)      { s.mineralWorkers++; }
+    if (job.returnsWorker)  { s.mineralWorkers++; }
+
+    if (action.supplyProvided > 0)
+    {
+        s.supplyPending -= action.supplyProvided;
+        s.supplyMax = std::min(MaxSupply, s.supplyMax + action.supplyProvided);
+    }
+
+    if (action.producer && s.producerCount < MaxProducers)
+    {
+        s.producers[s.producerCount++] = { s.frame, job.action };
+    }
+
+    // three on the geyser saturate it
+    if (action.refinery)
+    {
+        const int moved = std::min(3, s.mineralWorkers);
+        s.mineralWorkers -= moved;
+        s.gasWorkers += moved;
+    }
+}
+
+int BuildOrderSearch::nextJob(const State & s) const
+{
+    int next = -1;
+    for (int j = 0; j < s.jobCount; ++j)
+    {
+        if (next < 0 || s.jobs[j].finish < s.jobs[next].finish) { next = j; }
+    }
+    return next;
+}
+
+// gathers up to the frame, finishing the jobs due on the way in order
+void BuildOrderSearch::advanceTo(State & s, int frame) const
+{
+    for (int j = nextJob(s); j >= 0 && s.jobs[j].finish <= frame; j = nextJob(s))
+    {
+        gather(s, s.jobs[j].finish - s.frame);
+        s.frame = std::max(s.frame, s.jobs[j].finish);
+        finishJob(s, j);
+    }
+
+    gather(s, frame - s.frame);
+    s.frame = std::max(s.frame, frame);
+}
+
+// Whether starting the action is worth a branch: under its count, with everything it needs at
+// least started, and no depots while there is supply to spare.
+bool BuildOrderSearch::legal(const State & s, int a) const
+{
+    const Action & action = m_actions[a];
+    if (s.started[a] >= action.maxCount) { return false; }
+
+    for (uint32_t bits = action.required; bits; bits &= bits - 1)
+    {
+        if (s.started[std::countr_zero(bits)] == 0) { return false; }
+    }
+
+    if (action.builder >= 0 ? s.started[action.builder] == 0 : s.started[m_workerAction] == 0) { return false; }
+
+    const bool gasComing = s.gasWorkers > 0 || (m_refineryAction >= 0 && s.started[m_refineryAction] > 0);
+    if (action.gas > s.gas && !gasComing) { return false; }
+
+    const int freeSupply = s.supplyMax + s.supplyPending - s.supplyUsed;
+    if (action.supplyRequired > freeSupply) { return false; }
+
+    if (a == m_supplyAction && (freeSupply >= DepotSlack || s.supplyMax + s.supplyPending >= MaxSupply)) { return false; }
+
+    return true;
+}
+
+// Waits, finishing jobs as it goes, until the action can start, and starts it. False if it never
+// can: nothing left in production would unblock it.
+bool BuildOrderSearch::perform(State & s, int a) const
+{
+    const Action & action = m_actions[a];
+    if (s.jobCount == MaxJobs) { return false; }
+
+    int producer = -1;
+    for (;;)
+    {
+        int start = s.frame + std::max(FramesToAfford(s.minerals, s.mineralWorkers * MineralsPerWorkerFrame, Never, action.minerals),
+                                       FramesToAfford(s.gas, s.gasWorkers * GasPerWorkerFrame, Never, action.gas));
+
+        producer = -1;
+        if (action.builder >= 0)
+        {
+            for (int p = 0; p < s.producerCount; ++p)
+            {
+                if (s.producers[p].action != action.builder) { continue; }
+                if (producer < 0 || s.producers[p].freeAt < s.producers[producer].freeAt) { producer = p; }
+            }
+            start = producer < 0 ? Never : std::max(start, s.producers[producer].freeAt);
+        }
+        else if (s.mineralWorkers == 0)
+        {
+            start = Never;
+        }
+
+        for (uint32_t bits = action.required; bits; bits &= bits - 1)
+        {
+            if (s.completed[std::countr_zero(bits)] == 0) { start = Never; }
+        }
+
+        if (s.supplyUsed + action.supplyRequired > s.supplyMax) { start = Never; }
+
+        // something finishing first can change any of the above
+        const int j = nextJob(s);
+        if (j >= 0 && s.jobs[j].finish <= start)
+        {
+            advanceTo(s, s.jobs[j].finish);
+            continue;
+        }
+
+        if (start >= Never) { return false; }
+
+        advanceTo(s, start);
+        break;
+    }
+
+    s.minerals   -= action.minerals;
+    s.gas        -= action.gas;
+    s.supplyUsed += action.supplyRequired;
+    s.supplyPending += action.supplyProvided;
+    s.started[a]++;
+
+    const bool byWorker = action.builder < 0;
+    if (byWorker) { s.mineralWorkers--; }
+    else          { s.producers[producer].freeAt = s.frame + action.buildTime; }
+
+    s.jobs[s.jobCount++] = { s.frame + action.buildTime, (int8_t)a, byWorker };
+    return true;
+}
+
+bool BuildOrderSearch::goalMet(const State & s) const
+{
+    for (size_t a = 0; a < m_actions.size(); ++a)
+    {
+        if (s.started[a] < m_goal[a]) { return false; }
+    }
+    return true;
+}
+
+// when everything started so far has finished
+int BuildOrderSearch::makespan(const State & s) const
+{
+    int frame = s.frame;
+    for (int j = 0; j < s.jobCount; ++j)
+    {
+        frame = std::max(frame, s.jobs[j].finish);
+    }
+    return frame;
+}
+
+// earliest the action could start if money and supply were no object
+int BuildOrderSearch::readyFrame(const State & s, int a) const
+{
+    const Action & action = m_actions[a];
+    uint32_t needs = action.required;
+    if (action.builder >= 0) { needs |= 1u << action.builder; }
+
+    int ready = s.frame;
+    for (uint32_t bits = needs; bits; bits &= bits - 1)
+    {
+        const int r = std::countr_zero(bits);
+        if (s.completed[r] > 0) { continue; }
+
+        int finish = Never;
+        if (s.started[r] > 0)
+        {
+            for (int j = 0; j < s.jobCount; ++j)
+            {
+                if (s.jobs[j].action == r) { finish = std::min(finish, s.jobs[j].finish); }
+            }
+            if (finish == Never) { finish = s.frame; }
+        }
+        else
+        {
+            finish = readyFrame(s, r) + m_actions[r].buildTime;
+        }
+
+        ready = std::max(ready, finish);
+    }
+
+    return ready;
+}
+
+// No plan from this state finishes before: what is in production, each missing goal unit's chain
+// of requirements followed by as many rounds of production as the most producers we may have
+// need, and the time it takes to mine the rest of the goal's minerals at the best income we
+// could reach.
+int BuildOrderSearch::lowerBound(const State & s) const
+{
+    int bound = makespan(s);
+    double minerals = 0;
+
+    for (size_t a = 0; a < m_actions.size(); ++a)
+    {
+        const int remaining = m_goal[a] - s.started[a];
+        if (remaining <= 0) { continue; }
+
+        const Action & action = m_actions[a];
+        minerals += (double)remaining * action.minerals;
+
+        int rounds = 1;
+        if (action.builder >= 0)
+        {
+            const int producers = std::max(1, m_actions[action.builder].maxCount);
+            rounds = (remaining + producers - 1) / producers;
+        }
+
+        bound = std::max(bound, readyFrame(s, (int)a) + rounds * action.buildTime);
+    }
+
+    if (minerals > s.minerals && m_maxIncome > 0)
+    {
+        bound = std::max(bound, s.frame + (int)((minerals - s.minerals) / m_maxIncome));
+    }
+
+    return bound;
+}
+
+// Whether a state with the same counts, workers and roughly the same minerals was already reached
+// at this frame or earlier; records this one if not. The key leaves out when jobs finish, so two
+// states can share one while the later one is better off; the search takes that loss for the
+// branches it saves. Entries are single words, so threads race on them without locks.
+bool BuildOrderSearch::seen(const State & s)
+{
+    uint64_t hash = 1469598103934665603ull;
+    const auto mix = [&hash](uint64_t value) { hash = (hash ^ value) * 1099511628211ull; };
+
+    for (size_t a = 0; a < m_actions.size(); ++a)
+    {
+        mix((uint64_t)s.started[a] << 16 | (uint64_t)s.completed[a]);
+    }
+    mix((uint64_t)s.mineralWorkers << 16 | (uint64_t)s.gasWorkers);
+    mix((uint64_t)(s.minerals / 50));
+
+    const uint64_t FrameMask = (uint64_t(1) << 24) - 1;
+    const uint64_t key = hash & ~FrameMask;
+    const uint64_t frame = std::min<uint64_t>((uint64_t)s.frame, FrameMask);
+
+    std::atomic<uint64_t> & entry = m_table[hash & ((uint64_t(1) << TableBits) - 1)];
+    const uint64_t old = entry.load(std::memory_order_relaxed);
+    if ((old & ~FrameMask) == key && (old & FrameMask) <= frame) { return true; }
+
+    entry.store(key | frame, std::memory_order_relaxed);
+    return false;
+}
+
+// The first bound: the goal units in order, each preceded by whatever it is missing and by a
+// depot when supply runs out. No extra workers.
+void BuildOrderSearch::greedy(State s)
+{
+    Plan plan;
+    while (!goalMet(s) && plan.size() < MaxPlanLength)
+    {
+        int a = 0;
+        while (s.started[a] >= m_goal[a]) { ++a; }
+
+        // walk down to the first missing requirement
+        for (int depth = 0; depth < MaxActions; ++depth)
+        {
+            const Action & action = m_actions[a];
+            uint32_t needs = action.required;
+            if (action.builder >= 0) { needs |= 1u << action.builder; }
+
+            int missing = -1;
+            for (uint32_t bits = needs; bits && missing < 0; bits &= bits - 1)
+            {
+                if (s.started[std::countr_zero(bits)] == 0) { missing = std::countr_zero(bits); }
+            }
+            if (missing < 0 && action.gas > 0 && m_refineryAction >= 0 && s.started[m_refineryAction] == 0 && s.gasWorkers == 0)
+            {
+                missing = m_refineryAction;
+            }
+
+            if (missing < 0) { break; }
+            a = missing;
+        }
+
+        if (s.supplyUsed + m_actions[a].supplyRequired > s.supplyMax + s.supplyPending && legal(s, m_supplyAction))
+        {
+            a = m_supplyAction;
+        }
+
+        if (!legal(s, a) || !perform(s, a)) { return; }
+        plan.push_back((int8_t)a);
+    }
+
+    if (goalMet(s)) { offer(s, plan); }
+}
+
+void BuildOrderSearch::offer(const State & s, const Plan & plan)
+{
+    const int frame = makespan(s);
+    if (frame >= m_bestFrame.load(std::memory_order_relaxed)) { return; }
+
+    std::lock_guard<std::mutex> lock(m_bestMutex);
+    if (frame < m_bestFrame.load())
+    {
+        m_bestFrame = frame;
+        m_bestPlan = plan;
+    }
+}
+
+void BuildOrderSearch::dfs(const State & s, Plan & plan, int64_t & nodes)
+{
+    if (m_stop.load(std::memory_order_relaxed)) { return; }
+
+    // the shared counter and the clock are checked every 1024 nodes of each task
+    if ((++nodes & 1023) == 0)
+    {
+        if (m_nodes.fetch_add(1024) + 1024 >= MaxNodes || Clock::now() >= m_deadline)
+        {
+            m_stop = true;
+            return;
+        }
+    }
+
+    if (goalMet(s))
+    {
+        offer(s, plan);
+        return;
+    }
+
+    if (plan.size() >= MaxPlanLength) { return; }
+    if (lowerBound(s) >= m_bestFrame.load(std::memory_order_relaxed)) { return; }
+    if (seen(s)) { return; }
+
+    for (int a = 0; a < (int)m_actions.size(); ++a)
+    {
+        if (!legal(s, a)) { continue; }
+
+        State child = s;
+        if (!perform(child, a) || child.frame >= m_bestFrame.load(std::memory_order_relaxed)) { continue; }
+
+        plan.push_back((int8_t)a);
+        dfs(child, plan, nodes);
+        plan.pop_back();
+
+        if (m_stop.load(std::memory_order_relaxed)) { return; }
+    }
+}
+
+void BuildOrderSearch::finishTask()
+{
+    if (m_pending.fetch_sub(1) != 1) { return; }
+
+    m_elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - m_startTime).count();
+    m_status = Status::Finished;
+}
+
+bool BuildOrderSearch::start(ThreadPool & pool, const BuildScript::Goal & goal, int minerals, int gas)
+{
+    if (m_status == Status::Running) { return false; }
+
+    m_status = Status::Idle;
+    if (goal.empty() || BWAPI::Broodwar->self()->getRace() != BWAPI::Races::Terran) { return false; }
+    if (!buildActions(goal)) { return false; }
+
+    launch(pool, snapshot(minerals, gas));
+    return true;
+}
+
+void BuildOrderSearch::launch(ThreadPool & pool, const State & root)
+{
+    // how far each count may go: the goal, a few production buildings, one of everything else,
+    // and no more command centers than we have
+    for (size_t a = 0; a < m_actions.size(); ++a)
+    {
+        Action & action = m_actions[a];
+        const int current = root.started[a];
+
+        if (m_goal[a] > 0)                          { action.maxCount = std::max(m_goal[a], current); }
+        else if ((int)a == m_workerAction)          { action.maxCount = std::max(MaxWorkers, current); }
+        else if ((int)a == m_supplyAction)          { action.maxCount = current + MaxSupply / std::max(1, action.supplyProvided); }
+        else if (action.type.isResourceDepot())     { action.maxCount = current; }
+        else if (action.producer)                   { action.maxCount = std::max(2, current); }
+        else                                        { action.maxCount = std::max(1, current); }
+    }
+    m_maxIncome = m_actions[m_workerAction].maxCount * std::max(MineralsPerWorkerFrame, GasPerWorkerFrame);
+
+    for (size_t i = 0; i < (size_t(1) << TableBits); ++i)
+    {
+        m_table[i].store(0, std::memory_order_relaxed);
+    }
+
+    m_bestFrame = Never;
+    m_bestPlan.clear();
+    m_nodes = 0;
+    m_stop = false;
+    m_startTime = Clock::now();
+    m_deadline = m_startTime + std::chrono::milliseconds(TimeLimitMs);
+
+    greedy(root);
+
+    // the first two levels are expanded here, each node left is one task
+    std::vector<Subtree> frontier{ { root, {} } };
+    for (int depth = 0; depth < 2 && frontier.size() < 4 * pool.size(); ++depth)
+    {
+        std::vector<Subtree> next;
+        for (auto & node : frontier)
+        {
+            if (goalMet(node.state)) { offer(node.state, node.plan); continue; }
+
+            for (int a = 0; a < (int)m_actions.size(); ++a)
+            {
+                Subtree child = node;
+                if (!legal(node.state, a) || !perform(child.state, a)) { continue; }
+
+                child.plan.push_back((int8_t)a);
+                next.push_back(std::move(child));
+            }
+        }
+        frontier.swap(next);
+    }
+
+    m_status = Status::Running;
+    m_pending = (int)frontier.size() + 1;
+    for (auto & subtree : frontier)
+    {
+        pool.submit([this, subtree]() mutable
+        {
+            int64_t nodes = 0;
+            dfs(subtree.state, subtree.plan, nodes);
+            m_nodes += nodes & 1023;
+            finishTask();
+        });
+    }
+
+    // our own share, so an empty frontier still finishes
+    finishTask();
+}
+
+void BuildOrderSearch::cancel()
+{
+    m_stop = true;
+}
+
+bool BuildOrderSearch::running() const
+{
+    return m_status == Status::Running;
+}
+
+bool BuildOrderSearch::finished() const
+{
+    return m_status == Status::Finished;
+}
+
+std::vector<BWAPI::UnitType> BuildOrderSearch::takePlan()
+{
+    std::vector<BWAPI::UnitType> plan;
+    if (m_status != Status::Finished) { return plan; }
+
+    {
+        std::lock_guard<std::mutex> lock(m_bestMutex);
+        for (int8_t a : m_bestPlan)
+        {
+            plan.push_back(m_actions[a].type);
+        }
+    }
+
+    m_status = Status::Idle;
+    return plan;
+}
+
+int BuildOrderSearch::planFrame() const
+{
+    const int frame = m_bestFrame;
+    return frame == Never ? -1 : frame;
+}
+
+int64_t BuildOrderSearch::nodes() const
+{
+    return m_nodes;
+}
+
+double BuildOrderSearch::elapsedMs() const
+{
+    return m_elapsedMs;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "BuildScript.h"
+
+#include <BWAPI.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class ThreadPool;
+
+// Plans the fastest Terran build that reaches a goal unit mix, in the spirit of BOSS: a snapshot
+// of our economy and production is simulated forward in time, and a depth-first branch and bound
+// over the order of actions (units, buildings, supply, workers, a refinery) keeps the ordering
+// whose last unit finishes soonest.
+//
+// Everything the search needs from the game is copied out on the main thread when it starts, so
+// the search itself never calls BWAPI. Its first levels are split into ThreadPool tasks that run
+// while the game goes on; they share the best makespan found, so a good plan in one subtree prunes
+// the others, and a lock-free transposition table drops states another branch already reached no
+// later. A greedy plan gives the first bound, and node and time limits keep the search from
+// running long: the plan is the best one found by then. Poll finished() and takePlan() from the
+// main thread.
+class BuildOrderSearch
+{
+public:
+
+    static const int MaxActions = 16;               // unit types in the goal and what they need
+    static const int MaxJobs = 48;                  // units in production at once
+    static const int MaxProducers = 24;             // buildings that train units
+    static const int MaxWorkers = 30;               // SCVs the plan may have
+    static const int MaxPlanLength = 96;
+    static const int MaxSupply = 400;               // doubled, as BWAPI counts it
+    static const int DepotSlack = 16;               // free supply under which a depot is worth building
+    static const int TableBits = 20;                // transposition table entries, as a power of two
+    static const int64_t MaxNodes = 4000000;
+    static const int TimeLimitMs = 2000;
+
+    static constexpr double MineralsPerWorkerFrame = 0.045;
+    static constexpr double GasPerWorkerFrame = 0.07;
+
+private:
+
+    using Clock = std::chrono::steady_clock;
+
+    static const int Never = 1 << 28;               // frame of something that can't happen
+
+    // one word so the main thread never sees a search between running and finished
+    enum class Status : uint8_t { Idle, Running, Finished };
+
+    // what the search knows about a unit type, copied out of BWAPI before it starts
+    struct Action
+    {
+        BWAPI::UnitType type;
+        int             minerals = 0;
+        int             gas = 0;
+        int             buildTime = 0;
+        int             supplyRequired = 0;
+        int             supplyProvided = 0;
+        int             builder = -1;               // action that trains it, -1 if an SCV builds it
+        uint32_t        required = 0;               // actions that must be finished first, one bit each
+        int             maxCount = 0;               // started plus planned never goes past this
+        bool            producer = false;           // builder of another action
+        bool            refinery = false;
+        bool            worker = false;
+    };
+
+    struct Job
+    {
+        int             finish;
+        int8_t          action;
+        bool            returnsWorker;              // the SCV building it goes back to minerals
+    };
+
+    struct Producer
+    {
+        int             freeAt;
+        int8_t          action;
+    };
+
+    // the simulated game; plain data so a branch is a copy
+    struct State
+    {
+        int                                 frame = 0;
+        double                              minerals = 0;
+        double                              gas = 0;
+        int                                 mineralWorkers = 0;
+        int                                 gasWorkers = 0;
+        int                                 supplyUsed = 0;
+        int                                 supplyMax = 0;
+        int                                 supplyPending = 0;      // from depots being built
+        std::array<int16_t, MaxActions>     completed{};
+        std::array<int16_t, MaxActions>     started{};              // completed and in production
+        std::array<Job, MaxJobs>            jobs{};
+        std::array<Producer, MaxProducers>  producers{};
+        int                                 jobCount = 0;
+        int                                 producerCount = 0;
+    };
+
+    using Plan = std::vector<int8_t>;
+
+    struct Subtree
+    {
+        State   state;
+        Plan    plan;
+    };
+
+    // set up by start, read only while the tasks run
+    std::vector<Action>                 m_actions;
+    std::array<int, MaxActions>         m_goal{};
+    int                                 m_workerAction = -1;
+    int                                 m_supplyAction = -1;
+    int                                 m_refineryAction = -1;
+    double                              m_maxIncome = 0;            // minerals per frame with every worker we may have
+    Clock::time_point                   m_deadline;
+    Clock::time_point                   m_startTime;
+
+    // key in the high 40 bits, frame the state was reached in the low 24
+    std::unique_ptr<std::atomic<uint64_t>[]> m_table;
+
+    std::atomic<int>                    m_bestFrame{ Never };
+    std::mutex                          m_bestMutex;
+    Plan                                m_bestPlan;
+
+    std::atomic<int64_t>                m_nodes{ 0 };
+    std::atomic<int>                    m_pending{ 0 };
+    std::atomic<bool>                   m_stop{ false };
+    std::atomic<Status>                 m_status{ Status::Idle };
+    std::atomic<double>                 m_elapsedMs{ 0 };
+
+    int     actionOf(BWAPI::UnitType type) const;
+    int     addAction(BWAPI::UnitType type);
+    bool    buildActions(const BuildScript::Goal & goal);
+    State   snapshot(int minerals, int gas) const;
+
+    // simulation
+    void    gather(State & s, int frames) const;
+    void    finishJob(State & s, int job) const;
+    void    advanceTo(State & s, int frame) const;
+    int     nextJob(const State & s) const;
+    bool    legal(const State & s, int a) const;
+    bool    perform(State & s, int a) const;
+    bool    goalMet(const State & s) const;
+    int     makespan(const State & s) const;
+
+    // search
+    int     readyFrame(const State & s, int a) const;
+    int     lowerBound(const State & s) const;
+    bool    seen(const State & s);
+    void    greedy(State s);
+    void    offer(const State & s, const Plan & plan);
+    void    dfs(const State & s, Plan & plan, int64_t & nodes);
+    void    finishTask();
+    void    launch(ThreadPool & pool, const State & root);
+
+public:
+
+    BuildOrderSearch();
+
+    BuildOrderSearch(const BuildOrderSearch &) = delete;
+    void operator=(const BuildOrderSearch &) = delete;
+
+    // Starts a search from the current game towards the goal, with the minerals and gas not
+    // already spoken for. False if one is running or the goal can't be planned (not Terran, too
+    // many unit types); true if it was started, in which case finished() says when it is done.
+    bool    start(ThreadPool & pool, const BuildScript::Goal & goal, int minerals, int gas);
+
+    // the tasks stop at their next node check; finished() still turns true when they have
+    void    cancel();
+
+    bool    running() const;
+    bool    finished() const;
+
+    // the unit types to make, in order, once finished(); clears finished()
+    std::vector<BWAPI::UnitType> takePlan();
+
+    // of the last search
+    int     planFrame() const;              // frame the plan's last unit finishes
+    int64_t nodes() const;
+    double  elapsedMs() const;
+};
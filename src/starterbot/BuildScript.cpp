@@ -0,0 +1,208 @@
+#include "BuildScript.h"
+
+#include <fstream>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+const char * const BuildScript::DefaultScript = R"(
+strategy two_rax_academy
+train Terran_SCV x4
+build Terran_Refinery at geyser
+build Terran_Supply_Depot at supply @8
+train Terran_SCV x2
+build Terran_Barracks at production @10
+build Terran_Barracks at production @10
+train Terran_SCV x5
+build Terran_Supply_Depot at supply
+build Terran_Academy at production
+build Terran_Supply_Depot at supply
+build Terran_Supply_Depot at supply
+goal Terran_Marine x10 Terran_Medic x2
+)";
+
+namespace
+{
+    const char * AnchorNames[BuildScript::AnchorCount] = { "main", "supply", "production", "geyser" };
+
+    struct Line
+    {
+        int         number;
+        std::string text;
+    };
+
+    struct Strategy
+    {
+        std::string         name;
+        std::vector<Line>   lines;
+    };
+
+    void Report(int line, const std::string & message)
+    {
+        BWAPI::Broodwar->printf("Build order, line %d: %s", line, message.c_str());
+    }
+
+    BuildStep MakeStep(BWAPI::UnitType type, BWAPI::TilePosition tile, int supplyTrigger)
+    {
+        BuildStep step;
+        step.kind          = type.isBuilding() ? BuildStep::Build : BuildStep::Train;
+        step.done          = false;
+        step.unitType      = (int16_t)type.getID();
+        step.supplyTrigger = (int16_t)supplyTrigger;
+        step.minerals      = (int16_t)type.mineralPrice();
+        step.gas           = (int16_t)type.gasPrice();
+        step.tileX         = (int16_t)tile.x;
+        step.tileY         = (int16_t)tile.y;
+        return step;
+    }
+
+    // one step line, appended count times to steps; false with a message if it doesn't parse
+    bool CompileStep(const Line & line, const BuildScript::Anchors & anchors, std::vector<BuildStep> & steps)
+    {
+        std::istringstream in(line.text);
+        std::string verb, typeName;
+        in >> verb >> typeName;
+
+        if (verb != "build" && verb != "train") { Report(line.number, "unknown command '" + verb + "'"); return false; }
+
+        const BWAPI::UnitType type = BWAPI::UnitType::getType(typeName);
+        if (type == BWAPI::UnitTypes::Unknown || type == BWAPI::UnitTypes::None) { Report(line.number, "unknown unit type '" + typeName + "'"); return false; }
+
+        const bool build = verb == "build";
+        if (build != type.isBuilding()) { Report(line.number, typeName + (build ? " is not a building" : " is a building, use build")); return false; }
+
+        int count = 1;
+        int supply = 0;
+        BuildScript::Anchor anchor = BuildScript::Main;
+
+        std::string word;
+        while (in >> word)
+        {
+            if (word == "at" && build && in >> word)
+            {
+                int a = 0;
+                while (a < BuildScript::AnchorCount && word != AnchorNames[a]) { ++a; }
+                if (a == BuildScript::AnchorCount) { Report(line.number, "unknown anchor '" + word + "'"); return false; }
+                anchor = (BuildScript::Anchor)a;
+            }
+            else if (word.size() > 1 && word[0] == 'x' && std::isdigit((unsigned char)word[1]))
+            {
+                count = std::atoi(word.c_str() + 1);
+            }
+            else if (word.size() > 1 && word[0] == '@' && std::isdigit((unsigned char)word[1]))
+            {
+                supply = std::atoi(word.c_str() + 1);
+            }
+            else
+            {
+                Report(line.number, "unexpected '" + word + "'");
+                return false;
+            }
+        }
+
+        if (count < 1 || count > 100 || supply > 200) { Report(line.number, "count or supply out of range"); return false; }
+
+        const BWAPI::TilePosition tile = build ? anchors[anchor] : BWAPI::TilePositions::None;
+        if (build && !tile.isValid()) { Report(line.number, std::string("no ") + AnchorNames[anchor] + " location on this map"); return false; }
+
+        steps.insert(steps.end(), count, MakeStep(type, tile, supply));
+        return true;
+    }
+
+    // "goal <type> [xN] <type> [xN]...", added to what the goal already has
+    bool CompileGoal(const Line & line, BuildScript::Goal & goal)
+    {
+        std::istringstream in(line.text);
+        std::string word;
+        in >> word;
+
+        while (in >> word)
+        {
+            if (word.size() > 1 && word[0] == 'x' && std::isdigit((unsigned char)word[1]) && !goal.empty())
+            {
+                goal.back().second = std::atoi(word.c_str() + 1);
+                continue;
+            }
+
+            const BWAPI::UnitType type = BWAPI::UnitType::getType(word);
+            if (type == BWAPI::UnitTypes::Unknown || type == BWAPI::UnitTypes::None) { Report(line.number, "unknown unit type '" + word + "'"); return false; }
+
+            goal.push_back({ type, 1 });
+        }
+
+        return true;
+    }
+}
+
+std::string BuildScript::load(const std::string & path)
+{
+    std::ifstream fin(path);
+    if (!fin) { return std::string(); }
+
+    std::ostringstream text;
+    text << fin.rdbuf();
+    return text.str();
+}
+
+BuildScript::Program BuildScript::compile(const std::string & script, const Anchors & anchors)
+{
+    std::vector<Strategy> strategies;
+    std::string use;
+
+    // split the script into strategies, keeping line numbers for the messages
+    std::istringstream in(script);
+    std::string text;
+    for (int number = 1; std::getline(in, text); ++number)
+    {
+        const size_t comment = text.find('#');
+        if (comment != std::string::npos) { text.erase(comment); }
+
+        std::istringstream words(text);
+        std::string first, name;
+        if (!(words >> first)) { continue; }
+
+        if (first == "use" && words >> name)            { use = name; }
+        else if (first == "strategy" && words >> name)  { strategies.push_back({ name, {} }); }
+        else if (!strategies.empty())                   { strategies.back().lines.push_back({ number, text }); }
+        else                                            { Report(number, "step outside of a strategy"); }
+    }
+
+    Program program;
+    if (strategies.empty()) { return program; }
+
+    const Strategy * selected = &strategies.front();
+    for (auto & s : strategies)
+    {
+        if (s.name == use) { selected = &s; }
+    }
+    if (!use.empty() && selected->name != use)
+    {
+        BWAPI::Broodwar->printf("Build order: no strategy '%s', using '%s'", use.c_str(), selected->name.c_str());
+    }
+
+    for (auto & line : selected->lines)
+    {
+        std::istringstream words(line.text);
+        std::string first;
+        words >> first;
+
+        if (first == "goal") { CompileGoal(line, program.goal); }
+        else                 { CompileStep(line, anchors, program.steps); }
+    }
+
+    program.strategy = selected->name;
+    return program;
+}
+
+BuildStep BuildScript::makeStep(BWAPI::UnitType type, const Anchors & anchors, int supplyTrigger)
+{
+    BWAPI::TilePosition tile = BWAPI::TilePositions::None;
+    if (type.isBuilding())
+    {
+        if (type.isRefinery())              { tile = anchors[Geyser]; }
+        else if (type.supplyProvided() > 0 && !type.isResourceDepot()) { tile = anchors[Supply]; }
+        else                                { tile = anchors[Production]; }
+    }
+
+    return MakeStep(type, tile, supplyTrigger);
+}
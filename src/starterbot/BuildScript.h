@@ -0,0 +1,74 @@
+#pragma once
+
+#include <BWAPI.h>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// One step of a compiled build order. Steps are plain data so a whole build order is a single
+// contiguous table that BuildOrder walks with a cursor, switching on the kind instead of keeping
+// a heap-allocated object with virtual calls per step.
+struct BuildStep
+{
+    enum Kind : uint8_t { Build, Train };
+
+    Kind        kind;
+    bool        done;
+    int16_t     unitType;           // BWAPI::UnitTypes::Enum
+    int16_t     supplyTrigger;      // supply used (as shown in game) needed to start, 0 for none
+    int16_t     minerals;
+    int16_t     gas;
+    int16_t     tileX;              // build location seed, resolved when compiling
+    int16_t     tileY;
+
+    BWAPI::UnitType     type() const { return BWAPI::UnitType(unitType); }
+    BWAPI::TilePosition tile() const { return BWAPI::TilePosition(tileX, tileY); }
+};
+
+static_assert(std::is_trivially_copyable_v<BuildStep> && std::is_standard_layout_v<BuildStep>);
+
+// Build orders written as text, so strategies change by editing a file instead of recompiling.
+//
+//     # comment
+//     use two_rax                          strategy to run, the first one in the file if missing
+//     strategy two_rax                     starts a strategy
+//     train Terran_SCV x4                  four SCVs, one step each
+//     build Terran_Supply_Depot at supply @8
+//     goal Terran_Marine x10               what to have once the steps run out
+//
+// "build" takes an anchor the location is searched around (main, supply, production, geyser,
+// main if missing), "@n" holds the step until n supply is used, and "xn" repeats it. Unit type
+// names are BWAPI's (Terran_Supply_Depot), case and underscores don't matter. Goal lines add up;
+// when the steps are done and the goal isn't met, BuildOrderSearch plans the rest.
+namespace BuildScript
+{
+    enum Anchor { Main, Supply, Production, Geyser, AnchorCount };
+    using Anchors = std::array<BWAPI::TilePosition, AnchorCount>;
+
+    // unit types and how many of each to own
+    using Goal = std::vector<std::pair<BWAPI::UnitType, int>>;
+
+    struct Program
+    {
+        std::string             strategy;
+        std::vector<BuildStep>  steps;
+        Goal                    goal;
+    };
+
+    // the build order used when the file can't be read
+    extern const char * const DefaultScript;
+
+    // the whole file, or an empty string if it can't be opened
+    std::string load(const std::string & path);
+
+    // Compiles the selected strategy; lines that don't parse, and builds at an anchor that wasn't
+    // found, are reported in game and skipped.
+    Program compile(const std::string & script, const Anchors & anchors);
+
+    // a build step for the type at its usual anchor: refineries on the geyser, supply behind the
+    // main, everything else towards the choke. Train steps for units.
+    BuildStep makeStep(BWAPI::UnitType type, const Anchors & anchors, int supplyTrigger = 0);
+}
@@ -0,0 +1,226 @@
+#include "DebugOverlay.h"
+#include "Tools.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+DebugOverlay* DebugOverlay::instance = nullptr;
+
+namespace
+{
+    // chat command names, in Channel order
+    const char * ChannelNames[] = { "positions", "resources", "commands", "boxes", "health", "build" };
+    static_assert(sizeof(ChannelNames) / sizeof(ChannelNames[0]) == (size_t)DebugOverlay::Channel::Count);
+
+    // room kept for a line of debug text to the right of and below where it starts
+    const int TextWidth  = 200;
+    const int TextHeight = 12;
+}
+
+DebugOverlay::DebugOverlay()
+    : m_arena(ArenaSize)
+{
+    m_channels.fill(true);
+}
+
+DebugOverlay* DebugOverlay::getInstance()
+{
+    if (instance == nullptr) {
+        instance = new DebugOverlay();
+    }
+    return instance;
+}
+
+void DebugOverlay::beginFrame()
+{
+    // adjust the level of detail to how much the last frame asked for
+    if (m_requested > m_budget)
+    {
+        m_detailLevel = std::min(MaxDetailLevel, m_detailLevel + 1);
+    }
+    else if (m_requested < m_budget / 2)
+    {
+        m_detailLevel = std::max(0, m_detailLevel - 1);
+    }
+
+    m_lastScreen = m_screen;
+    m_screen     = BWAPI::Broodwar->getScreenPosition();
+    m_drawn      = 0;
+    m_requested  = 0;
+    m_arenaUsed  = 0;
+    m_guiEnabled = BWAPI::Broodwar->isGUIEnabled();
+}
+
+void DebugOverlay::setBudget(int shapes)
+{
+    m_budget = shapes;
+}
+
+int DebugOverlay::remaining() const
+{
+    return std::max(0, m_budget - m_drawn);
+}
+
+int DebugOverlay::detailLevel() const
+{
+    return m_detailLevel;
+}
+
+int DebugOverlay::drawnThisFrame() const
+{
+    return m_drawn;
+}
+
+bool DebugOverlay::cameraMoved() const
+{
+    return m_screen != m_lastScreen;
+}
+
+const BWAPI::Position & DebugOverlay::screen() const
+{
+    return m_screen;
+}
+
+bool DebugOverlay::onScreen(int left, int top, int right, int bottom) const
+{
+    return right >= m_screen.x && left <= m_screen.x + Tools::SCREEN_WIDTH &&
+           bottom >= m_screen.y && top <= m_screen.y + Tools::SCREEN_HEIGHT;
+}
+
+bool DebugOverlay::onScreen(const Shape & shape) const
+{
+    return onScreen(std::min(shape.x1, shape.x2), std::min(shape.y1, shape.y2), std::max(shape.x1, shape.x2), std::max(shape.y1, shape.y2));
+}
+
+void DebugOverlay::emit(const Shape & shape)
+{
+    if (shape.type == Shape::Type::Box)
+    {
+        BWAPI::Broodwar->drawBoxMap(shape.x1, shape.y1, shape.x2, shape.y2, shape.color, shape.solid);
+    }
+    else
+    {
+        BWAPI::Broodwar->drawLineMap(shape.x1, shape.y1, shape.x2, shape.y2, shape.color);
+    }
+
+    ++m_drawn;
+}
+
+bool DebugOverlay::box(int left, int top, int right, int bottom, BWAPI::Color color, bool solid)
+{
+    if (!onScreen(left, top, right, bottom)) { return false; }
+
+    ++m_requested;
+    if (m_drawn >= m_budget) { return false; }
+
+    emit({ Shape::Type::Box, left, top, right, bottom, color, solid });
+    return true;
+}
+
+bool DebugOverlay::line(int x1, int y1, int x2, int y2, BWAPI::Color color)
+{
+    const Shape shape = { Shape::Type::Line, x1, y1, x2, y2, color, false };
+    if (!onScreen(shape)) { return false; }
+
+    ++m_requested;
+    if (m_drawn >= m_budget) { return false; }
+
+    emit(shape);
+    return true;
+}
+
+bool DebugOverlay::draw(const ShapeList & shapes)
+{
+    int visible = 0;
+    for (auto & shape : shapes)
+    {
+        if (onScreen(shape)) { ++visible; }
+    }
+
+    m_requested += visible;
+    if (m_drawn + visible > m_budget) { return false; }
+
+    for (auto & shape : shapes)
+    {
+        if (onScreen(shape)) { emit(shape); }
+    }
+
+    return true;
+}
+
+bool DebugOverlay::toggleChannel(const std::string & name)
+{
+    if (name == "debug")
+    {
+        const bool anyOn = std::find(m_channels.begin(), m_channels.end(), true) != m_channels.end();
+        m_channels.fill(!anyOn);
+        return true;
+    }
+
+    for (size_t c = 0; c < m_channels.size(); ++c)
+    {
+        if (name == ChannelNames[c])
+        {
+            m_channels[c] = !m_channels[c];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char * DebugOverlay::vformat(const char * format, va_list args)
+{
+    char * out = m_arena.data() + m_arenaUsed;
+    const size_t room = m_arena.size() - m_arenaUsed;
+
+    const int length = std::vsnprintf(out, room, format, args);
+    if (length < 0 || (size_t)length >= room) { return nullptr; }
+
+    m_arenaUsed += length + 1;
+    return out;
+}
+
+const char * DebugOverlay::format(const char * format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const char * text = vformat(format, args);
+    va_end(args);
+    return text;
+}
+
+bool DebugOverlay::text(int x, int y, const char * format, ...)
+{
+    if (!onScreen(x, y, x + TextWidth, y + TextHeight)) { return false; }
+
+    ++m_requested;
+    if (m_drawn >= m_budget) { return false; }
+
+    va_list args;
+    va_start(args, format);
+    const char * text = vformat(format, args);
+    va_end(args);
+    if (!text) { return false; }
+
+    BWAPI::Broodwar->drawTextMap(x, y, "%s", text);
+    ++m_drawn;
+    return true;
+}
+
+bool DebugOverlay::textScreen(int x, int y, const char * format, ...)
+{
+    ++m_requested;
+    if (m_drawn >= m_budget) { return false; }
+
+    va_list args;
+    va_start(args, format);
+    const char * text = vformat(format, args);
+    va_end(args);
+    if (!text) { return false; }
+
+    BWAPI::Broodwar->drawTextScreen(x, y, "%s", text);
+    ++m_drawn;
+    return true;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <BWAPI.h>
+#include <array>
+#include <cstdarg>
+#include <string>
+#include <vector>
+
+// Front end for the debug drawing that goes through BWAPI's shape buffer (GameData::MAX_SHAPES
+// shapes shared by everything drawn on a frame). Shapes are culled to the viewport, counted
+// against a per-frame budget, and dropped once the budget is spent. Callers that draw a lot can
+// keep a ShapeList across frames and only rebuild it when what it shows changes, and can check
+// detailLevel(), which goes up when the previous frame asked for more than the budget and comes
+// back down once there is room again.
+//
+// Each debug pass belongs to a channel that can be switched with a chat command ("/positions",
+// "/debug" for all of them). A pass checks enabled() before doing anything, so a channel that is
+// off, or any channel when the game runs without a GUI, costs one test. Text is formatted into an
+// arena that is reset every frame instead of into strings of its own.
+class DebugOverlay
+{
+public:
+
+    struct Shape
+    {
+        enum class Type { Box, Line };
+
+        Type            type;
+        int             x1, y1, x2, y2;     // map coordinates
+        BWAPI::Color    color;
+        bool            solid;
+    };
+
+    using ShapeList = std::vector<Shape>;
+
+    // 0 draws everything, 1 leaves out decoration, 2 only draws what carries information
+    static const int MaxDetailLevel = 2;
+
+    enum class Channel { Positions, Resources, Commands, BoundingBoxes, HealthBars, BuildOrder, Count };
+
+    static const size_t ArenaSize = 64 * 1024;
+
+private:
+
+    static DebugOverlay* instance;
+
+    BWAPI::Position     m_screen;
+    BWAPI::Position     m_lastScreen = BWAPI::Positions::None;
+    int                 m_budget = 4000;
+    int                 m_drawn = 0;
+    int                 m_requested = 0;
+    int                 m_detailLevel = 0;
+    std::array<bool, (size_t)Channel::Count> m_channels;
+    bool                m_guiEnabled = true;
+    std::vector<char>   m_arena;
+    size_t              m_arenaUsed = 0;
+
+    DebugOverlay();
+
+    bool onScreen(const Shape & shape) const;
+    void emit(const Shape & shape);
+    const char * vformat(const char * format, va_list args);
+
+public:
+
+    DebugOverlay(DebugOverlay& other) = delete;
+    void operator=(const DebugOverlay&) = delete;
+
+    static DebugOverlay* getInstance();
+
+    // called once at the start of every frame, before anything draws
+    void    beginFrame();
+
+    void    setBudget(int shapes);
+    int     remaining() const;
+    int     detailLevel() const;
+    int     drawnThisFrame() const;
+    bool    cameraMoved() const;
+    const BWAPI::Position & screen() const;
+
+    // whether a rectangle in map coordinates overlaps the viewport
+    bool    onScreen(int left, int top, int right, int bottom) const;
+
+    // immediate shapes, culled and budgeted; return false if the shape was not drawn
+    bool    box(int left, int top, int right, int bottom, BWAPI::Color color, bool solid = false);
+    bool    line(int x1, int y1, int x2, int y2, BWAPI::Color color);
+
+    // draws the on-screen part of a cached list, all or nothing: returns false and draws none of
+    // it if it would go over the budget, so a list never shows up half drawn
+    bool    draw(const ShapeList & shapes);
+
+    inline bool enabled(Channel channel) const { return m_guiEnabled && m_channels[(size_t)channel]; }
+
+    // switches the channel with the given name, false if there is none; "debug" switches all of
+    // them, off if any was on
+    bool    toggleChannel(const std::string & name);
+
+    // printf into this frame's arena, nullptr once the arena is full
+    const char * format(const char * format, ...);
+
+    // text at a map position, culled and budgeted like the shapes, and text on the screen
+    bool    text(int x, int y, const char * format, ...);
+    bool    textScreen(int x, int y, const char * format, ...);
+};
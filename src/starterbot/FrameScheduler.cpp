@@ -0,0 +1,176 @@
+#include "FrameScheduler.h"
+#include "Profiler.h"
+
+#include <BWAPI.h>
+#include <algorithm>
+
+namespace
+{
+    // least time left in the frame worth starting a sliced task with
+    const double MinSliceMs = 0.5;
+
+    double MillisecondsSince(FrameScheduler::Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(FrameScheduler::Clock::now() - start).count();
+    }
+}
+
+FrameScheduler::FrameScheduler()
+{
+
+}
+
+void FrameScheduler::add(const std::string & name, Priority priority, int period, Task task, double budgetMs)
+{
+    addSliced(name, priority, period, [task](Clock::time_point) { task(); return true; }, budgetMs);
+    m_entries.back().sliced = false;
+}
+
+void FrameScheduler::addSliced(const std::string & name, Priority priority, int period, SlicedTask task, double budgetMs)
+{
+    Entry entry;
+    entry.name     = name;
+    entry.priority = priority;
+    entry.period   = std::max(1, period);
+    entry.budgetMs = budgetMs;
+    entry.run      = task;
+    entry.sliced   = true;
+#if STARTERBOT_PROFILER
+    entry.profileName = Profiler::getInstance()->nameId(name.c_str());
+#endif
+    m_entries.push_back(entry);
+}
+
+void FrameScheduler::clear()
+{
+    m_entries.clear();
+    m_lastFrameMs = 0;
+    m_maxFrameMs = 0;
+}
+
+bool FrameScheduler::isDue(const Entry & entry, int frame) const
+{
+    return entry.unfinished || entry.lastRun < 0 || frame - entry.lastRun >= entry.period;
+}
+
+// How long a run is expected to take. A sliced task stops at its deadline so it fits in any
+// time left; other tasks are assumed to take their recent average, or their budget until they
+// have run once.
+double FrameScheduler::estimateMs(const Entry & entry) const
+{
+    if (entry.sliced)    { return MinSliceMs; }
+    if (entry.runs == 0) { return entry.budgetMs; }
+
+    return entry.averageMs;
+}
+
+void FrameScheduler::onFrame()
+{
+    PROFILE_SCOPE("FrameScheduler::onFrame");
+
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point frameDeadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(m_frameLimitMs));
+    const int frame = BWAPI::Broodwar->getFrameCount();
+
+    m_due.clear();
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        if (isDue(m_entries[i], frame)) { m_due.push_back(i); }
+    }
+
+    // most important first, and within a priority the tasks that have waited longest; the sort is
+    // stable so tasks that tie keep the order they were registered in
+    std::stable_sort(m_due.begin(), m_due.end(), [this](size_t a, size_t b)
+    {
+        const Entry & ea = m_entries[a];
+        const Entry & eb = m_entries[b];
+        if (ea.priority != eb.priority) { return ea.priority < eb.priority; }
+        return ea.deferrals > eb.deferrals;
+    });
+
+    m_deferredThisFrame = 0;
+    for (size_t i : m_due)
+    {
+        Entry & entry = m_entries[i];
+        const double remaining = m_frameLimitMs - MillisecondsSince(start);
+
+        const bool mustRun = entry.priority == Priority::Critical || entry.deferrals >= MaxDeferrals;
+        if (!mustRun && estimateMs(entry) > remaining)
+        {
+            ++entry.deferrals;
+            ++m_deferredThisFrame;
+            continue;
+        }
+
+        const Clock::time_point runStart = Clock::now();
+        Clock::time_point deadline = frameDeadline;
+        if (entry.budgetMs > 0)
+        {
+            deadline = std::min(deadline, runStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(entry.budgetMs)));
+        }
+
+        bool finished;
+        {
+#if STARTERBOT_PROFILER
+            Profiler::Scope scope(entry.profileName);
+#endif
+            finished = entry.run(deadline);
+        }
+        const double ms = MillisecondsSince(runStart);
+
+        entry.lastMs     = ms;
+        entry.averageMs  = entry.runs == 0 ? ms : entry.averageMs + (ms - entry.averageMs) / 8;
+        entry.maxMs      = std::max(entry.maxMs, ms);
+        entry.deferrals  = 0;
+        entry.unfinished = !finished;
+        ++entry.runs;
+
+        if (finished) { entry.lastRun = frame; }
+    }
+
+    m_lastFrameMs = MillisecondsSince(start);
+    m_maxFrameMs = std::max(m_maxFrameMs, m_lastFrameMs);
+    PROFILE_COUNT("deferred tasks", m_deferredThisFrame);
+
+    if (m_drawStats)
+    {
+        draw(440, 30);
+    }
+}
+
+void FrameScheduler::setFrameLimit(double ms)
+{
+    m_frameLimitMs = ms;
+}
+
+double FrameScheduler::frameLimit() const
+{
+    return m_frameLimitMs;
+}
+
+double FrameScheduler::lastFrameMs() const
+{
+    return m_lastFrameMs;
+}
+
+double FrameScheduler::maxFrameMs() const
+{
+    return m_maxFrameMs;
+}
+
+void FrameScheduler::toggleDraw()
+{
+    m_drawStats = !m_drawStats;
+}
+
+void FrameScheduler::draw(int x, int y) const
+{
+    BWAPI::Broodwar->drawTextScreen(x, y, "Frame %.1f ms (max %.1f / %.0f), %d deferred", m_lastFrameMs, m_maxFrameMs, m_frameLimitMs, m_deferredThisFrame);
+
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        const Entry & entry = m_entries[i];
+        BWAPI::Broodwar->drawTextScreen(x, y + 12 * (int)(i + 1), "%s: %.2f avg %.2f max%s",
+            entry.name.c_str(), entry.averageMs, entry.maxMs, entry.deferrals > 0 ? " (deferred)" : "");
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Runs the bot's per-frame work under a time limit. Each task is registered with a priority, how
+// often it wants to run (every N frames) and optionally how much time it gets per run. Every
+// frame the due tasks run most important first; a task that doesn't look like it will fit in
+// what is left of the frame is put off to the next one, where it is first in line among tasks of
+// its priority. Critical tasks always run.
+//
+// Sliced tasks do their work in pieces: they get a deadline, stop when they reach it, and return
+// false if they haven't finished, in which case they stay due and carry on the next frame.
+class FrameScheduler
+{
+public:
+
+    using Clock      = std::chrono::high_resolution_clock;
+    using Task       = std::function<void()>;
+    using SlicedTask = std::function<bool(Clock::time_point deadline)>;
+
+    enum class Priority { Critical, High, Normal, Low };
+
+    // tournaments disqualify bots for frames over 55 ms, this leaves room for BWAPI's own work
+    static constexpr double DefaultFrameLimitMs = 40.0;
+
+    // a task put off this many frames in a row runs next frame even if it doesn't seem to fit
+    static const int MaxDeferrals = 24;
+
+private:
+
+    struct Entry
+    {
+        std::string name;
+        Priority    priority;
+        int         period;
+        double      budgetMs;       // 0 if the task has no budget of its own
+        SlicedTask  run;
+        bool        sliced;         // whether run stops at the deadline it is given
+
+        int         lastRun = -1;       // frame it last finished a run
+        bool        unfinished = false; // sliced task in the middle of its work
+        int         deferrals = 0;      // frames in a row it was due and didn't run
+        double      lastMs = 0;
+        double      averageMs = 0;
+        double      maxMs = 0;
+        int         runs = 0;
+        int         profileName = -1;   // Profiler name of the task's scope
+    };
+
+    std::vector<Entry>  m_entries;
+    std::vector<size_t> m_due;
+    double              m_frameLimitMs = DefaultFrameLimitMs;
+    double              m_lastFrameMs = 0;
+    double              m_maxFrameMs = 0;
+    int                 m_deferredThisFrame = 0;
+    bool                m_drawStats = false;
+
+    bool    isDue(const Entry & entry, int frame) const;
+    double  estimateMs(const Entry & entry) const;
+
+public:
+
+    FrameScheduler();
+
+    void    add(const std::string & name, Priority priority, int period, Task task, double budgetMs = 0);
+    void    addSliced(const std::string & name, Priority priority, int period, SlicedTask task, double budgetMs = 0);
+    void    clear();
+
+    // runs this frame's tasks, called once from onFrame
+    void    onFrame();
+
+    void    setFrameLimit(double ms);
+    double  frameLimit() const;
+    double  lastFrameMs() const;
+    double  maxFrameMs() const;
+
+    void    toggleDraw();
+    void    draw(int x, int y) const;
+};
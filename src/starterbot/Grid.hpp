@@ -1,14 +1,73 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <span>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 
+// A read/write view over every n-th element of a buffer, used to walk a grid column
+// without copying it out. Rows of a Grid are contiguous, so columns are strided.
+template <class T>
+class StridedView
+{
+    T *     m_begin  = nullptr;
+    size_t  m_size   = 0;
+    size_t  m_stride = 1;
+
+public:
+
+    class iterator
+    {
+        T *     m_ptr    = nullptr;
+        size_t  m_stride = 1;
+
+    public:
+
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::remove_cv_t<T>;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = T *;
+        using reference         = T &;
+
+        iterator() {}
+        iterator(T * ptr, size_t stride) : m_ptr(ptr), m_stride(stride) {}
+
+        inline T & operator * () const { return *m_ptr; }
+        inline iterator & operator ++ () { m_ptr += m_stride; return *this; }
+        inline iterator operator ++ (int) { iterator it = *this; m_ptr += m_stride; return it; }
+        inline bool operator == (const iterator & rhs) const { return m_ptr == rhs.m_ptr; }
+        inline bool operator != (const iterator & rhs) const { return m_ptr != rhs.m_ptr; }
+    };
+
+    StridedView() {}
+
+    StridedView(T * begin, size_t size, size_t stride)
+        : m_begin(begin)
+        , m_size(size)
+        , m_stride(stride)
+    {
+
+    }
+
+    inline T & operator [] (size_t i) const { return m_begin[i*m_stride]; }
+    inline size_t size() const { return m_size; }
+    inline iterator begin() const { return iterator(m_begin, m_stride); }
+    inline iterator end() const { return iterator(m_begin + m_size*m_stride, m_stride); }
+};
+
+// 2D grid of values stored as one contiguous row-major buffer: (x, y) lives at y*width + x.
+// Sweeps should iterate y in the outer loop and x in the inner loop to stay sequential.
 template <class T>
 class Grid
 {
     size_t m_width = 0;
     size_t m_height = 0;
 
-    std::vector<std::vector<T>> m_grid;
+    std::vector<T> m_data;
 
 public:
 
@@ -17,24 +76,207 @@ public:
     Grid(size_t width, size_t height, T val)
         : m_width(width)
         , m_height(height)
-        , m_grid(width, std::vector<T>(height, val))
+        , m_data(width * height, val)
     {
 
     }
 
     inline T & get(size_t x, size_t y)
     {
-        return m_grid[x][y];
+        return m_data[y * m_width + x];
     }
 
     inline const T & get(size_t x, size_t y) const
     {
-        return m_grid[x][y];
+        return m_data[y * m_width + x];
     }
 
     inline void set(size_t x, size_t y, T val)
     {
-        m_grid[x][y] = val;
+        m_data[y * m_width + x] = val;
+    }
+
+    inline void fill(T val)
+    {
+        std::fill(m_data.begin(), m_data.end(), val);
+    }
+
+    // all the cells of row y, left to right
+    inline std::span<T> row(size_t y)
+    {
+        return std::span<T>(m_data.data() + y * m_width, m_width);
+    }
+
+    inline std::span<const T> row(size_t y) const
+    {
+        return std::span<const T>(m_data.data() + y * m_width, m_width);
+    }
+
+    // all the cells of column x, top to bottom
+    inline StridedView<T> column(size_t x)
+    {
+        return StridedView<T>(m_data.data() + x, m_height, m_width);
+    }
+
+    inline StridedView<const T> column(size_t x) const
+    {
+        return StridedView<const T>(m_data.data() + x, m_height, m_width);
+    }
+
+    inline T * data()
+    {
+        return m_data.data();
+    }
+
+    inline const T * data() const
+    {
+        return m_data.data();
+    }
+
+    inline size_t size() const
+    {
+        return m_data.size();
+    }
+
+    inline size_t width() const
+    {
+        return m_width;
+    }
+
+    inline size_t height() const
+    {
+        return m_height;
+    }
+};
+
+// Bit-packed boolean grid. Each row starts on a fresh 64-bit word so rows can be combined
+// word-at-a-time, and the padding bits past the width of a row are always kept at zero so
+// that count() and the bitwise operators never see garbage.
+template <>
+class Grid<bool>
+{
+public:
+
+    using Word = uint64_t;
+    static constexpr size_t WordBits = 64;
+
+private:
+
+    size_t m_width = 0;
+    size_t m_height = 0;
+    size_t m_wordsPerRow = 0;
+
+    std::vector<Word> m_words;
+
+    inline Word lastWordMask() const
+    {
+        const size_t used = m_width % WordBits;
+        return used == 0 ? ~Word(0) : (Word(1) << used) - 1;
+    }
+
+public:
+
+    Grid() {}
+
+    Grid(size_t width, size_t height, bool val)
+        : m_width(width)
+        , m_height(height)
+        , m_wordsPerRow((width + WordBits - 1) / WordBits)
+        , m_words(m_wordsPerRow * height, 0)
+    {
+        fill(val);
+    }
+
+    inline bool get(size_t x, size_t y) const
+    {
+        return (m_words[y * m_wordsPerRow + x / WordBits] >> (x % WordBits)) & 1;
+    }
+
+    inline void set(size_t x, size_t y, bool val)
+    {
+        Word & word = m_words[y * m_wordsPerRow + x / WordBits];
+        const Word bit = Word(1) << (x % WordBits);
+        word = val ? (word | bit) : (word & ~bit);
+    }
+
+    inline void fill(bool val)
+    {
+        std::fill(m_words.begin(), m_words.end(), val ? ~Word(0) : Word(0));
+
+        if (val && m_wordsPerRow > 0)
+        {
+            const Word mask = lastWordMask();
+            for (size_t y(0); y < m_height; ++y)
+            {
+                m_words[y * m_wordsPerRow + m_wordsPerRow - 1] &= mask;
+            }
+        }
+    }
+
+    // the packed words of row y, bit i of word w is the cell x = w*64 + i
+    inline std::span<Word> rowWords(size_t y)
+    {
+        return std::span<Word>(m_words.data() + y * m_wordsPerRow, m_wordsPerRow);
+    }
+
+    inline std::span<const Word> rowWords(size_t y) const
+    {
+        return std::span<const Word>(m_words.data() + y * m_wordsPerRow, m_wordsPerRow);
+    }
+
+    inline Word * data()
+    {
+        return m_words.data();
+    }
+
+    inline const Word * data() const
+    {
+        return m_words.data();
+    }
+
+    // number of set cells in the whole grid
+    inline size_t count() const
+    {
+        size_t sum = 0;
+        for (Word w : m_words) { sum += std::popcount(w); }
+        return sum;
+    }
+
+    // number of set cells in row y
+    inline size_t countRow(size_t y) const
+    {
+        size_t sum = 0;
+        for (Word w : rowWords(y)) { sum += std::popcount(w); }
+        return sum;
+    }
+
+    inline bool any() const
+    {
+        for (Word w : m_words) { if (w) { return true; } }
+        return false;
+    }
+
+    // cell-wise and / or with another grid of the same dimensions
+    inline Grid<bool> & operator &= (const Grid<bool> & rhs)
+    {
+        for (size_t i(0); i < m_words.size(); ++i) { m_words[i] &= rhs.m_words[i]; }
+        return *this;
+    }
+
+    inline Grid<bool> & operator |= (const Grid<bool> & rhs)
+    {
+        for (size_t i(0); i < m_words.size(); ++i) { m_words[i] |= rhs.m_words[i]; }
+        return *this;
+    }
+
+    inline size_t wordsPerRow() const
+    {
+        return m_wordsPerRow;
+    }
+
+    inline size_t wordCount() const
+    {
+        return m_words.size();
     }
 
     inline size_t width() const
@@ -46,4 +288,4 @@ public:
     {
         return m_height;
     }
-};
\ No newline at end of file
+};
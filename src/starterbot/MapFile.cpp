@@ -0,0 +1,351 @@
+#include "MapFile.h"
+
+#include <fstream>
+#include <sstream>
+#include <charconv>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <bit>
+#include <algorithm>
+
+namespace
+{
+    const char      BinaryMagic[4] = { 'S', 'D', 'M', 'B' };
+    const uint32_t  BinaryVersion  = 1;
+
+    void PutU32(std::string & out, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i) { out.push_back((char)((v >> (8 * i)) & 0xFF)); }
+    }
+
+    // little endian base 128, so short runs only take a single byte
+    void PutVarint(std::string & out, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back((char)((v & 0x7F) | 0x80));
+            v >>= 7;
+        }
+        out.push_back((char)v);
+    }
+
+    // Reads values back out of a binary map file, every read fails once we run off the end
+    class Reader
+    {
+        const std::string & m_data;
+        size_t              m_pos = 0;
+        bool                m_ok = true;
+
+    public:
+
+        Reader(const std::string & data, size_t pos) : m_data(data), m_pos(pos) {}
+
+        bool ok() const { return m_ok; }
+
+        uint8_t u8()
+        {
+            if (m_pos >= m_data.size()) { m_ok = false; return 0; }
+            return (uint8_t)m_data[m_pos++];
+        }
+
+        uint32_t u32()
+        {
+            uint32_t v = 0;
+            for (int i = 0; i < 4; ++i) { v |= (uint32_t)u8() << (8 * i); }
+            return v;
+        }
+
+        uint64_t varint()
+        {
+            uint64_t v = 0;
+            for (int shift = 0; m_ok && shift < 64; shift += 7)
+            {
+                const uint8_t b = u8();
+                v |= (uint64_t)(b & 0x7F) << shift;
+                if (!(b & 0x80)) { return v; }
+            }
+            m_ok = false;
+            return 0;
+        }
+    };
+
+    bool ReadFile(const std::string & path, std::string & contents)
+    {
+        std::ifstream fin(path, std::ios::binary);
+        if (!fin) { return false; }
+
+        std::ostringstream ss;
+        ss << fin.rdbuf();
+        contents = ss.str();
+        return true;
+    }
+
+    bool WriteFile(const std::string & path, const std::string & contents, bool binary)
+    {
+        std::ofstream fout(path, binary ? std::ios::binary : std::ios::out);
+        if (!fout) { return false; }
+
+        fout.write(contents.data(), contents.size());
+        return (bool)fout;
+    }
+
+    // Splits text into lines without copying, dropping the '\r' of Windows line endings
+    class LineReader
+    {
+        const std::string & m_text;
+        size_t              m_pos = 0;
+
+    public:
+
+        LineReader(const std::string & text) : m_text(text) {}
+
+        bool next(std::string_view & line)
+        {
+            if (m_pos >= m_text.size()) { return false; }
+
+            size_t end = m_text.find('\n', m_pos);
+            if (end == std::string::npos) { end = m_text.size(); }
+
+            line = std::string_view(m_text).substr(m_pos, end - m_pos);
+            if (!line.empty() && line.back() == '\r') { line.remove_suffix(1); }
+
+            m_pos = end + 1;
+            return true;
+        }
+    };
+
+    // Parses whitespace separated integers from a line
+    bool ParseInts(std::string_view line, std::vector<int> & values)
+    {
+        values.clear();
+        const char * p = line.data();
+        const char * end = line.data() + line.size();
+
+        while (p < end)
+        {
+            while (p < end && (*p == ' ' || *p == '\t')) { ++p; }
+            if (p == end) { break; }
+
+            int v = 0;
+            const auto result = std::from_chars(p, end, v);
+            if (result.ec != std::errc()) { return false; }
+
+            values.push_back(v);
+            p = result.ptr;
+        }
+
+        return true;
+    }
+}
+
+MapFile::MapFile()
+{
+
+}
+
+bool MapFile::load(const std::string & path)
+{
+    std::string contents;
+    if (!ReadFile(path, contents)) { return false; }
+
+    if (contents.size() >= sizeof(BinaryMagic) && std::memcmp(contents.data(), BinaryMagic, sizeof(BinaryMagic)) == 0)
+    {
+        return loadBinary(contents);
+    }
+
+    return loadText(contents);
+}
+
+bool MapFile::loadText(const std::string & contents)
+{
+    LineReader lines(contents);
+    std::string_view line;
+    std::vector<int> values;
+
+    // width and height
+    if (!lines.next(line) || !ParseInts(line, values) || values.size() != 2) { return false; }
+    width  = values[0];
+    height = values[1];
+    if (width <= 0 || height <= 0) { return false; }
+
+    // number of start locations followed by their x y pairs
+    if (!lines.next(line) || !ParseInts(line, values) || values.empty()) { return false; }
+    if (values.size() != 1 + 2 * (size_t)values[0]) { return false; }
+    startLocations.clear();
+    for (int i = 0; i < values[0]; ++i)
+    {
+        startLocations.emplace_back(values[1 + 2 * i], values[2 + 2 * i]);
+    }
+
+    // one row of tile type characters per build tile row
+    tileTypes = Grid<char>(width, height, 0);
+    for (int y = 0; y < height; ++y)
+    {
+        if (!lines.next(line) || line.size() < (size_t)width) { return false; }
+        std::memcpy(tileTypes.row(y).data(), line.data(), width);
+    }
+
+    // one row of '0' / '1' per walk tile row
+    walkTiles = Grid<bool>(width * 4, height * 4, false);
+    for (int y = 0; y < height * 4; ++y)
+    {
+        if (!lines.next(line) || line.size() < (size_t)width * 4) { return false; }
+        for (int x = 0; x < width * 4; ++x)
+        {
+            if (line[x] == '1') { walkTiles.set(x, y, true); }
+        }
+    }
+
+    return true;
+}
+
+bool MapFile::loadBinary(const std::string & contents)
+{
+    Reader in(contents, sizeof(BinaryMagic));
+    if (in.u32() != BinaryVersion) { return false; }
+
+    width  = (int)in.u32();
+    height = (int)in.u32();
+    if (!in.ok() || width <= 0 || height <= 0 || width > 256 || height > 256) { return false; }
+
+    const uint32_t starts = in.u32();
+    startLocations.clear();
+    for (uint32_t i = 0; in.ok() && i < starts; ++i)
+    {
+        const int x = (int)in.u32();
+        const int y = (int)in.u32();
+        startLocations.emplace_back(x, y);
+    }
+
+    // tile types are (character, run length) pairs in row major order
+    tileTypes = Grid<char>(width, height, 0);
+    const size_t tileCount = tileTypes.size();
+    for (size_t i = 0; in.ok() && i < tileCount; )
+    {
+        const char type = (char)in.u8();
+        const uint64_t run = in.varint();
+        if (run == 0 || run > tileCount - i) { return false; }
+
+        std::fill(tileTypes.data() + i, tileTypes.data() + i + run, type);
+        i += run;
+    }
+
+    // walk tiles are the value of the first walk tile, then alternating run lengths
+    const size_t walkWidth = (size_t)width * 4;
+    const size_t walkCount = walkWidth * height * 4;
+    walkTiles = Grid<bool>(walkWidth, (size_t)height * 4, false);
+    bool value = in.u8() != 0;
+    for (size_t i = 0; in.ok() && i < walkCount; value = !value)
+    {
+        const uint64_t run = in.varint();
+        if (run > walkCount - i) { return false; }
+
+        if (value)
+        {
+            for (size_t j = i; j < i + run; ++j) { walkTiles.set(j % walkWidth, j / walkWidth, true); }
+        }
+        i += run;
+    }
+
+    return in.ok();
+}
+
+// Writes the StarDraft text format, a whole row at a time into one buffer that is written once
+bool MapFile::saveText(const std::string & path) const
+{
+    std::string out;
+    out.reserve((size_t)(width + 1) * height + (size_t)(width * 4 + 1) * height * 4 + 64);
+
+    // the width and height of the map
+    out += std::to_string(width) + " " + std::to_string(height) + "\n";
+
+    // all the possible starting locations
+    out += std::to_string(startLocations.size());
+    for (auto & tile : startLocations)
+    {
+        out += " " + std::to_string(tile.first) + " " + std::to_string(tile.second);
+    }
+    out += "\n";
+
+    // the character of the type of each tile
+    for (int y = 0; y < height; ++y)
+    {
+        const auto row = tileTypes.row(y);
+        out.append(row.data(), row.size());
+        out += '\n';
+    }
+
+    // the walk tiles, '1' if walkable
+    for (size_t y = 0; y < walkTiles.height(); ++y)
+    {
+        for (size_t x = 0; x < walkTiles.width(); ++x)
+        {
+            out += walkTiles.get(x, y) ? '1' : '0';
+        }
+        out += '\n';
+    }
+
+    return WriteFile(path, out, false);
+}
+
+// Writes the run-length encoded binary format, which is a fraction of the size of the text one
+bool MapFile::saveBinary(const std::string & path) const
+{
+    std::string out(BinaryMagic, sizeof(BinaryMagic));
+    PutU32(out, BinaryVersion);
+    PutU32(out, width);
+    PutU32(out, height);
+
+    PutU32(out, (uint32_t)startLocations.size());
+    for (auto & tile : startLocations)
+    {
+        PutU32(out, (uint32_t)tile.first);
+        PutU32(out, (uint32_t)tile.second);
+    }
+
+    // tile types as (character, run length) pairs
+    const char * tiles = tileTypes.data();
+    for (size_t i = 0; i < tileTypes.size(); )
+    {
+        size_t j = i + 1;
+        while (j < tileTypes.size() && tiles[j] == tiles[i]) { ++j; }
+
+        out.push_back(tiles[i]);
+        PutVarint(out, j - i);
+        i = j;
+    }
+
+    // walk tiles as alternating run lengths, counting equal bits a word at a time
+    bool value = walkTiles.width() > 0 && walkTiles.height() > 0 && walkTiles.get(0, 0);
+    out.push_back(value ? 1 : 0);
+
+    uint64_t run = 0;
+    for (size_t y = 0; y < walkTiles.height(); ++y)
+    {
+        const auto words = walkTiles.rowWords(y);
+        for (size_t x = 0; x < walkTiles.width(); )
+        {
+            const size_t bit   = x % Grid<bool>::WordBits;
+            const size_t valid = std::min(Grid<bool>::WordBits - bit, walkTiles.width() - x);
+            const uint64_t word = words[x / Grid<bool>::WordBits] >> bit;
+
+            // the first bit that differs from the current run's value ends the run
+            const uint64_t diff = value ? ~word : word;
+            const size_t same = std::min<size_t>(diff == 0 ? Grid<bool>::WordBits : std::countr_zero(diff), valid);
+
+            run += same;
+            x += same;
+
+            if (same < valid)
+            {
+                PutVarint(out, run);
+                value = !value;
+                run = 0;
+            }
+        }
+    }
+    PutVarint(out, run);
+
+    return WriteFile(path, out, true);
+}
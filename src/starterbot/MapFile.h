@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Grid.hpp"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+// A map in the StarDraft format, https://github.com/davechurchill/stardraft/wiki/Map-File-Syntax
+// It does not depend on BWAPI, so offline tools can read the files the bot writes to replaydata/maps.
+// Maps can be stored as the StarDraft text format or as a run-length encoded binary file,
+// and load() tells the two apart on its own.
+class MapFile
+{
+    bool loadText(const std::string & contents);
+    bool loadBinary(const std::string & contents);
+
+public:
+
+    int                                 width = 0;       // in build tiles
+    int                                 height = 0;      // in build tiles
+    std::vector<std::pair<int, int>>    startLocations;  // build tile of every start location
+    Grid<char>                          tileTypes;       // StarDraft tile type of each build tile
+    Grid<bool>                          walkTiles;       // walkability at walk tile resolution
+
+    MapFile();
+
+    bool load(const std::string & path);
+    bool saveText(const std::string & path) const;
+    bool saveBinary(const std::string & path) const;
+};
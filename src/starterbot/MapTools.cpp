@@ -1,9 +1,137 @@
 #include "MapTools.h"
+#include "MappedFile.h"
+#include "Profiler.h"
 
+#include <BWAPI/Client.h>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <array>
+#include <algorithm>
+#include <cstdint>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+    #include <emmintrin.h>
+    #define MAPTOOLS_SSE2
+#endif
+
+namespace
+{
+    // Packs a map layer that GameData stores column-major (layer[x][y], one byte per cell) into
+    // a row-major bit grid. Eight bytes of a column are loaded as one little-endian word, and
+    // since every byte is 0 or 1, shifting column c left by c and or-ing eight columns together
+    // transposes an 8x8 block: byte r of the result holds the eight column bits of row y + r.
+    void PackColumnMajor(const bool * layer, size_t columnSize, Grid<bool> & dst)
+    {
+        const size_t width = dst.width();
+        const size_t height = dst.height();
+
+        for (size_t x = 0; x < width; x += 8)
+        {
+            const size_t cols = std::min<size_t>(8, width - x);
+            for (size_t y = 0; y < height; y += 8)
+            {
+                uint64_t block = 0;
+                for (size_t c = 0; c < cols; ++c)
+                {
+                    uint64_t column;
+                    std::memcpy(&column, layer + (x + c) * columnSize + y, sizeof(column));
+                    block |= (column & 0x0101010101010101ull) << c;
+                }
+
+                const size_t rows = std::min<size_t>(8, height - y);
+                for (size_t r = 0; r < rows; ++r)
+                {
+                    dst.rowWords(y + r)[x / 64] |= ((block >> (8 * r)) & 0xFF) << (x % 64);
+                }
+            }
+        }
+    }
+
+    // Binary map cache: a header, a table of sections, then the raw bytes of every section.
+    // Bump MapCacheVersion whenever the layout or the meaning of any section changes.
+    const char      MapCacheMagic[4] = { 'S', 'B', 'M', 'C' };
+    const uint32_t  MapCacheVersion  = 1;
+
+    struct MapCacheHeader
+    {
+        char        magic[4];
+        uint32_t    version;
+        uint32_t    width;
+        uint32_t    height;
+        char        mapHash[48];
+        uint32_t    sectionCount;
+        uint32_t    reserved;
+    };
+
+    struct MapCacheSection
+    {
+        uint64_t    offset;
+        uint64_t    size;
+    };
+
+    template <class T>
+    std::pair<unsigned char *, size_t> LayerBytes(Grid<T> & grid)
+    {
+        return { reinterpret_cast<unsigned char *>(grid.data()), grid.size() * sizeof(T) };
+    }
+
+    std::pair<unsigned char *, size_t> LayerBytes(Grid<bool> & grid)
+    {
+        return { reinterpret_cast<unsigned char *>(grid.data()), grid.wordCount() * sizeof(Grid<bool>::Word) };
+    }
+
+    // a build reservation that hasn't turned into a building after this many frames is dropped
+    const int ReservationFrames = 24 * 30;
+
+    // whether every tile of a rectangle is set, from a summed-area table with a zero first row and column
+    bool RectFree(const Grid<int> & sums, int x, int y, int w, int h)
+    {
+        if (x < 0 || y < 0 || x + w >= (int)sums.width() || y + h >= (int)sums.height()) { return false; }
+
+        const int sum = sums.get(x + w, y + h) - sums.get(x, y + h) - sums.get(x + w, y) + sums.get(x, y);
+        return sum == w * h;
+    }
+
+    // Gathers the bits at positions 0, 4, 8, ... 60 of a word into its low 16 bits
+    uint64_t CompressNibbles(uint64_t v)
+    {
+        v = (v | (v >> 3))  & 0x0303030303030303ull;
+        v = (v | (v >> 6))  & 0x000F000F000F000Full;
+        v = (v | (v >> 12)) & 0x000000FF000000FFull;
+        v = (v | (v >> 24)) & 0x000000000000FFFFull;
+        return v;
+    }
+
+    // Reduces every 4x4 block of walk tiles to one build tile, 16 build tiles per walk word:
+    // 'all' gets the bit when all 16 walk tiles are walkable, 'any' when at least one is
+    void ReduceWalkTiles(const Grid<bool> & walk, Grid<bool> & all, Grid<bool> & any)
+    {
+        const uint64_t nibbleLow = 0x1111111111111111ull;
+
+        for (size_t ty = 0; ty < all.height(); ++ty)
+        {
+            const auto r0 = walk.rowWords(ty * 4 + 0);
+            const auto r1 = walk.rowWords(ty * 4 + 1);
+            const auto r2 = walk.rowWords(ty * 4 + 2);
+            const auto r3 = walk.rowWords(ty * 4 + 3);
+            const auto allRow = all.rowWords(ty);
+            const auto anyRow = any.rowWords(ty);
+
+            for (size_t w = 0; w < walk.wordsPerRow(); ++w)
+            {
+                const uint64_t a = r0[w] & r1[w] & r2[w] & r3[w];
+                const uint64_t o = r0[w] | r1[w] | r2[w] | r3[w];
+
+                allRow[w / 4] |= CompressNibbles(a & (a >> 1) & (a >> 2) & (a >> 3) & nibbleLow) << (16 * (w % 4));
+                anyRow[w / 4] |= CompressNibbles((o | (o >> 1) | (o >> 2) | (o >> 3)) & nibbleLow) << (16 * (w % 4));
+            }
+        }
+    }
+}
 
 // constructor for MapTools
 MapTools::MapTools()
@@ -18,26 +146,97 @@ const std::string& MapTools::mapName() const
 
 void MapTools::onStart()
 {
+    PROFILE_SCOPE("MapTools::onStart");
+
     m_mapName        = fixMapName(BWAPI::Broodwar->mapName());
     m_width          = BWAPI::Broodwar->mapWidth();
     m_height         = BWAPI::Broodwar->mapHeight();
-    m_walkable       = Grid<int>(m_width, m_height, 1);
-    m_buildable      = Grid<int>(m_width, m_height, 0);
-    m_depotBuildable = Grid<int>(m_width, m_height, 0);
     m_lastSeen       = Grid<int>(m_width, m_height, 0);
-    m_tileType       = Grid<char>(m_width, m_height, 0);
+    m_visible        = Grid<bool>(m_width, m_height, false);
+    m_unreachableField = Grid<int>(m_width, m_height, -1);
+    m_frame          = 0;
+
+    m_distanceFields.clear();
+    m_distanceFieldIndex.clear();
 
-    // Set the boolean grid data from the Map
-    for (int x(0); x < m_width; ++x)
+    // nothing has been seen yet, so every visible tile will show up as a change on the first frame
+    m_prevVisible.assign(sizeof(BWAPI::GameData::isVisible), 0);
+    m_visibilityChanges.clear();
+
+    // the static layers only depend on the map, so reuse them if we've played this map before
+    const std::string cachePath = getCachePath();
+    if (!loadCache(cachePath))
     {
-        for (int y(0); y < m_height; ++y)
-        {
-            m_buildable.set(x, y, canBuild(x, y));
-            m_depotBuildable.set(x, y, canBuild(x, y));
-            m_walkable.set(x, y, m_buildable.get(x,y) || canWalk(x, y));
-        }
+        computeStaticLayers();
+        saveCache(cachePath);
     }
 
+    m_pathFinder.init(m_walkable);
+
+    // building placement index, starting from the buildings that are already on the map
+    m_blocked      = Grid<uint8_t>(m_width, m_height, 0);
+    m_freeSum      = Grid<int>(m_width + 1, m_height + 1, 0);
+    m_depotFreeSum = Grid<int>(m_width + 1, m_height + 1, 0);
+    m_buildings.clear();
+    m_reservations.clear();
+    m_drawCacheScreen = BWAPI::TilePositions::None;
+    updatePlacementSums(0, 0);
+
+    for (auto & unit : BWAPI::Broodwar->getAllUnits())
+    {
+        addBuilding(unit);
+    }
+}
+
+void MapTools::allocateStaticLayers()
+{
+    m_walkable       = Grid<bool>(m_width, m_height, false);
+    m_walkableAll    = Grid<bool>(m_width, m_height, false);
+    m_walkableAny    = Grid<bool>(m_width, m_height, false);
+    m_walkTiles      = Grid<bool>(m_width * 4, m_height * 4, false);
+    m_buildable      = Grid<bool>(m_width, m_height, false);
+    m_depotBuildable = Grid<bool>(m_width, m_height, false);
+    m_tileType       = Grid<char>(m_width, m_height, 0);
+    m_clearance      = Grid<uint16_t>(m_width * 4, m_height * 4, 0);
+}
+
+// The raw storage of every layer that only depends on the map, in the order the cache stores them
+std::vector<std::pair<unsigned char *, size_t>> MapTools::staticLayerBytes()
+{
+    return
+    {
+        LayerBytes(m_walkable),
+        LayerBytes(m_walkableAll),
+        LayerBytes(m_walkableAny),
+        LayerBytes(m_walkTiles),
+        LayerBytes(m_buildable),
+        LayerBytes(m_depotBuildable),
+        LayerBytes(m_tileType),
+        LayerBytes(m_clearance)
+    };
+}
+
+// Computes every layer that only depends on the map itself, which is what the cache stores
+void MapTools::computeStaticLayers()
+{
+    allocateStaticLayers();
+
+    // Read the static terrain straight out of shared memory rather than one virtual call per cell,
+    // then derive the build tile walkability layers from the walk tile bitboard
+    const BWAPI::GameData * data = BWAPI::BWAPIClient.data;
+    PackColumnMajor(&data->isWalkable[0][0], sizeof(data->isWalkable[0]), m_walkTiles);
+    PackColumnMajor(&data->isBuildable[0][0], sizeof(data->isBuildable[0]), m_buildable);
+    ReduceWalkTiles(m_walkTiles, m_walkableAll, m_walkableAny);
+
+    // a tile is walkable if it's buildable or if every walk tile inside it is walkable
+    m_walkable = m_buildable;
+    m_walkable |= m_walkableAll;
+
+    computeClearance();
+
+    // depots start out buildable exactly where anything else is, resources are cut out below
+    m_depotBuildable = m_buildable;
+
     // set tiles that static resources are on as unbuildable
     for (auto & resource : BWAPI::Broodwar->getStaticNeutralUnits())
     {
@@ -68,7 +267,7 @@ void MapTools::onStart()
                             continue;
                         }
 
-                        m_depotBuildable.set(x+rx, y+ry, 0);
+                        m_depotBuildable.set(x+rx, y+ry, false);
                     }
                 }
             }
@@ -76,9 +275,9 @@ void MapTools::onStart()
     }
 
     // set the other tile types
-    for (int x(0); x < m_width; ++x)
+    for (int y(0); y < m_height; ++y)
     {
-        for (int y(0); y < m_height; ++y)
+        for (int x(0); x < m_width; ++x)
         {
             // if it has a type already it's a mineral or a gas
             if (m_tileType.get(x, y) != 0) { continue; }
@@ -90,25 +289,210 @@ void MapTools::onStart()
     }
 }
 
-void MapTools::onFrame()
+// Chessboard distance transform over the walk tiles: after a forward pass that looks at the
+// already-finished neighbours above and to the left, and a backward pass that looks below and
+// to the right, each cell holds the distance to the closest unwalkable walk tile.
+// Everything outside the map counts as unwalkable, so tiles on the map edge get 1.
+// Expects m_clearance to have just been zeroed by allocateStaticLayers.
+void MapTools::computeClearance()
 {
-    for (int x=0; x<m_width; ++x)
+    const int w = m_width * 4;
+    const int h = m_height * 4;
+    const uint16_t far = UINT16_MAX - 1;
+
+    for (int y = 0; y < h; ++y)
     {
-        for (int y=0; y<m_height; ++y)
+        const auto row = m_clearance.row(y);
+        const uint16_t * up = y > 0 ? m_clearance.row(y - 1).data() : nullptr;
+
+        for (int x = 0; x < w; ++x)
         {
-            if (isVisible(x, y))
-            {
-                m_lastSeen.set(x, y, BWAPI::Broodwar->getFrameCount());
-            }
+            if (!m_walkTiles.get(x, y)) { continue; }
+
+            uint16_t d = far;
+            d = std::min<uint16_t>(d, x > 0 ? row[x - 1] : 0);
+            d = std::min<uint16_t>(d, up && x > 0 ? up[x - 1] : 0);
+            d = std::min<uint16_t>(d, up ? up[x] : 0);
+            d = std::min<uint16_t>(d, up && x < w - 1 ? up[x + 1] : 0);
+            row[x] = d + 1;
+        }
+    }
+
+    for (int y = h - 1; y >= 0; --y)
+    {
+        const auto row = m_clearance.row(y);
+        const uint16_t * down = y < h - 1 ? m_clearance.row(y + 1).data() : nullptr;
+
+        for (int x = w - 1; x >= 0; --x)
+        {
+            if (row[x] == 0) { continue; }
+
+            uint16_t d = row[x] - 1;
+            d = std::min<uint16_t>(d, x < w - 1 ? row[x + 1] : 0);
+            d = std::min<uint16_t>(d, down && x < w - 1 ? down[x + 1] : 0);
+            d = std::min<uint16_t>(d, down ? down[x] : 0);
+            d = std::min<uint16_t>(d, down && x > 0 ? down[x - 1] : 0);
+            row[x] = d + 1;
+        }
+    }
+}
+
+// map analysis is cached per map file, keyed by the hash BWAPI computes over its contents
+std::string MapTools::getCachePath() const
+{
+    return "bwapi-data/write/mapcache/" + BWAPI::Broodwar->mapHash() + ".bin";
+}
+
+// Maps the cache file for this map into memory and copies its layers out. Returns false,
+// leaving the layers to be computed from scratch, if the file is missing, from an older
+// version of the format, or was written for a different map.
+bool MapTools::loadCache(const std::string & path)
+{
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(MapCacheHeader)) { return false; }
+
+    MapCacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    const std::string hash = BWAPI::Broodwar->mapHash();
+    if (std::memcmp(header.magic, MapCacheMagic, sizeof(MapCacheMagic)) != 0) { return false; }
+    if (header.version != MapCacheVersion) { return false; }
+    if (header.width != (uint32_t)m_width || header.height != (uint32_t)m_height) { return false; }
+    if (hash.compare(0, sizeof(header.mapHash) - 1, header.mapHash) != 0) { return false; }
+
+    allocateStaticLayers();
+    const auto layers = staticLayerBytes();
+    if (header.sectionCount != layers.size()) { return false; }
+    if (file.size() < sizeof(header) + layers.size() * sizeof(MapCacheSection)) { return false; }
+
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        MapCacheSection section;
+        std::memcpy(&section, file.data() + sizeof(header) + i * sizeof(section), sizeof(section));
+
+        if (section.size != layers[i].second || section.offset + section.size > file.size()) { return false; }
+        std::memcpy(layers[i].first, file.data() + section.offset, layers[i].second);
+    }
+
+    return true;
+}
+
+// Writes the static layers to a temporary file and renames it into place, so a game that is
+// reading the cache for the same map never sees a half written file
+void MapTools::saveCache(const std::string & path)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+    const auto layers = staticLayerBytes();
+
+    MapCacheHeader header = {};
+    std::memcpy(header.magic, MapCacheMagic, sizeof(MapCacheMagic));
+    header.version      = MapCacheVersion;
+    header.width        = m_width;
+    header.height       = m_height;
+    header.sectionCount = (uint32_t)layers.size();
+    std::strncpy(header.mapHash, BWAPI::Broodwar->mapHash().c_str(), sizeof(header.mapHash) - 1);
+
+    std::vector<MapCacheSection> sections(layers.size());
+    uint64_t offset = sizeof(header) + sections.size() * sizeof(MapCacheSection);
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        sections[i] = { offset, layers[i].second };
+        offset += layers[i].second;
+    }
+
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream fout(tempPath, std::ios::binary);
+        if (!fout) { return; }
+
+        fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        fout.write(reinterpret_cast<const char *>(sections.data()), sections.size() * sizeof(MapCacheSection));
+        for (const auto & layer : layers)
+        {
+            fout.write(reinterpret_cast<const char *>(layer.first), layer.second);
         }
+
+        if (!fout) { return; }
     }
 
+    std::filesystem::rename(tempPath, path, ec);
+}
+
+void MapTools::onFrame()
+{
+    PROFILE_SCOPE("MapTools::onFrame");
+
+    m_frame = BWAPI::Broodwar->getFrameCount();
+
+    updateVisibility();
+    expireReservations();
+}
+
+void MapTools::onDraw() const
+{
     if (m_drawMap)
     {
         draw();
     }
 }
 
+// Diffs the shared memory visibility array against the copy taken on the previous frame,
+// 16 tiles at a time, and only touches the tiles whose visibility actually changed.
+// GameData stores visibility as isVisible[x][y], so each 256 byte block is one column.
+void MapTools::updateVisibility()
+{
+    m_visibilityChanges.clear();
+
+    const BWAPI::GameData * data = BWAPI::BWAPIClient.data;
+    if (!data) { return; }
+
+    const unsigned char * curr = reinterpret_cast<const unsigned char *>(&data->isVisible[0][0]);
+    unsigned char *       prev = m_prevVisible.data();
+    const size_t          columnSize = sizeof(data->isVisible[0]);
+    const size_t          bytes = m_width * columnSize;
+    const size_t          blockSize = 16;
+
+    for (size_t i = 0; i < bytes; i += blockSize)
+    {
+#ifdef MAPTOOLS_SSE2
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(curr + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prev + i));
+        unsigned int changed = ~_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & 0xFFFF;
+        if (changed == 0) { continue; }
+#else
+        if (std::memcmp(curr + i, prev + i, blockSize) == 0) { continue; }
+        unsigned int changed = 0;
+        for (size_t j = 0; j < blockSize; ++j) { changed |= (curr[i + j] != prev[i + j]) << j; }
+#endif
+
+        while (changed)
+        {
+            const size_t index = i + std::countr_zero(changed);
+            changed &= changed - 1;
+
+            const int x = (int)(index / columnSize);
+            const int y = (int)(index % columnSize);
+            if (y < m_height)
+            {
+                onVisibilityChanged(x, y, curr[index] != 0);
+            }
+        }
+
+        std::memcpy(prev + i, curr + i, blockSize);
+    }
+}
+
+void MapTools::onVisibilityChanged(int tileX, int tileY, bool visible)
+{
+    // a visible tile is seen on every frame, so we only need to stamp the edges: the frame it
+    // came into sight, and the last frame it was still in sight once it goes back into the fog
+    m_lastSeen.set(tileX, tileY, visible ? m_frame : m_frame - 1);
+    m_visible.set(tileX, tileY, visible);
+    m_visibilityChanges.emplace_back(tileX, tileY);
+}
+
 void MapTools::toggleDraw()
 {
     m_drawMap = !m_drawMap;
@@ -131,11 +515,27 @@ bool MapTools::isExplored(int tileX, int tileY) const
     return BWAPI::Broodwar->isExplored(tileX, tileY);
 }
 
+// as of this frame's onFrame, from the bitboard the visibility diff keeps, so consumers of
+// getVisibilityChanges don't go back to BWAPI for every tile
 bool MapTools::isVisible(int tileX, int tileY) const
 {
     if (!isValidTile(tileX, tileY)) { return false; }
 
-    return BWAPI::Broodwar->isVisible(BWAPI::TilePosition(tileX, tileY));
+    return m_visible.get(tileX, tileY);
+}
+
+// the last frame on which any of our units could see this tile, 0 if it has never been seen
+int MapTools::lastSeen(int tileX, int tileY) const
+{
+    if (!isValidTile(tileX, tileY)) { return 0; }
+
+    return m_visible.get(tileX, tileY) ? m_frame : m_lastSeen.get(tileX, tileY);
+}
+
+// tiles that became visible or hidden on the current frame, check isVisible for which
+const std::vector<BWAPI::TilePosition>& MapTools::getVisibilityChanges() const
+{
+    return m_visibilityChanges;
 }
 
 bool MapTools::isPowered(int tileX, int tileY) const
@@ -158,6 +558,104 @@ bool MapTools::isValidPosition(const BWAPI::Position & pos) const
     return isValidTile(BWAPI::TilePosition(pos));
 }
 
+// Returns the ground distance field towards a target tile: every tile holds the number of
+// 4-connected walkable steps to the target, or -1 if it can't reach it. Fields are computed on
+// first use and then served from an LRU cache, so the reference is only guaranteed to stay
+// valid until the next call that has to compute a new field. A target off the map gets a field
+// where nothing is reachable, which is not cached: its key would alias a tile on the map.
+const Grid<int>& MapTools::getDistanceField(const BWAPI::TilePosition & target) const
+{
+    if (!isValidTile(target)) { return m_unreachableField; }
+
+    const int key = target.y * m_width + target.x;
+
+    auto it = m_distanceFieldIndex.find(key);
+    if (it != m_distanceFieldIndex.end())
+    {
+        m_distanceFields.splice(m_distanceFields.begin(), m_distanceFields, it->second);
+        return it->second->second;
+    }
+
+    // make room for the new field before we allocate it, always keeping at least the new one
+    const size_t fieldBytes = sizeof(int) * m_width * m_height;
+    while (!m_distanceFields.empty() && (m_distanceFields.size() + 1) * fieldBytes > m_distanceFieldBudget)
+    {
+        m_distanceFieldIndex.erase(m_distanceFields.back().first);
+        m_distanceFields.pop_back();
+    }
+
+    m_distanceFields.emplace_front(key, Grid<int>(m_width, m_height, -1));
+    m_distanceFieldIndex[key] = m_distanceFields.begin();
+    computeDistanceField(target, m_distanceFields.front().second);
+
+    return m_distanceFields.front().second;
+}
+
+// breadth first search outward from the target over walkable tiles
+void MapTools::computeDistanceField(const BWAPI::TilePosition & target, Grid<int> & dist) const
+{
+    m_bfsQueue.resize(m_width * m_height);
+    size_t head = 0;
+    size_t tail = 0;
+
+    dist.set(target.x, target.y, 0);
+    m_bfsQueue[tail++] = target.y * m_width + target.x;
+
+    const int dx[4] = { 1, -1, 0, 0 };
+    const int dy[4] = { 0, 0, 1, -1 };
+
+    while (head < tail)
+    {
+        const int index = m_bfsQueue[head++];
+        const int x = index % m_width;
+        const int y = index / m_width;
+        const int d = dist.get(x, y) + 1;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            const int nx = x + dx[i];
+            const int ny = y + dy[i];
+
+            if (!isWalkable(nx, ny) || dist.get(nx, ny) != -1) { continue; }
+
+            dist.set(nx, ny, d);
+            m_bfsQueue[tail++] = ny * m_width + nx;
+        }
+    }
+}
+
+// number of walkable tile steps between two tiles, -1 if there is no ground path
+int MapTools::getGroundDistance(const BWAPI::TilePosition & from, const BWAPI::TilePosition & to) const
+{
+    if (!isValidTile(from) || !isValidTile(to)) { return -1; }
+
+    return getDistanceField(to).get(from.x, from.y);
+}
+
+// same as above but in pixels, measured tile to tile
+int MapTools::getGroundDistance(const BWAPI::Position & from, const BWAPI::Position & to) const
+{
+    const int tiles = getGroundDistance(BWAPI::TilePosition(from), BWAPI::TilePosition(to));
+    return tiles < 0 ? -1 : tiles * 32;
+}
+
+void MapTools::setDistanceFieldBudget(size_t bytes)
+{
+    m_distanceFieldBudget = bytes;
+}
+
+// walkable tile path from start to goal as a list of jump points, see PathFinder
+bool MapTools::findPath(const BWAPI::TilePosition & start, const BWAPI::TilePosition & goal, std::vector<BWAPI::TilePosition> & path)
+{
+    return m_pathFinder.findPath(start, goal, path);
+}
+
+// plans a whole batch of paths at once, e.g. one for every unit of a squad
+void MapTools::findPaths(const std::vector<std::pair<BWAPI::TilePosition, BWAPI::TilePosition>> & requests, std::vector<std::vector<BWAPI::TilePosition>> & paths)
+{
+    m_pathFinder.findPaths(requests, paths);
+}
+
 bool MapTools::isBuildable(int tileX, int tileY) const
 {
     if (!isValidTile(tileX, tileY))
@@ -173,6 +671,150 @@ bool MapTools::isBuildable(const BWAPI::TilePosition & tile) const
     return isBuildable(tile.x, tile.y);
 }
 
+// Stamps a building into the placement index. Called for every building we see created, shown
+// or morphed; a building that is already stamped at the same tile with the same type is skipped,
+// and one that changed type is re-stamped. Lifted off Terran buildings are not tracked.
+void MapTools::addBuilding(BWAPI::Unit unit)
+{
+    if (!unit || !unit->getType().isBuilding() || unit->isLifted()) { return; }
+
+    const size_t id = (size_t)unit->getID();
+    if (id >= m_buildings.size()) { m_buildings.resize(id + 1); }
+
+    Footprint & building = m_buildings[id];
+    const BWAPI::TilePosition tile = unit->getTilePosition();
+    if (building.type == unit->getType() && building.tile == tile) { return; }
+
+    if (building.type != BWAPI::UnitTypes::None) { blockFootprint(building.tile, building.type, -1); }
+    building = { tile, unit->getType(), m_frame };
+    blockFootprint(tile, building.type, 1);
+
+    // the building now blocks the tiles itself, so whatever reservation was waiting for it goes
+    for (auto it = m_reservations.begin(); it != m_reservations.end(); ++it)
+    {
+        if (it->tile == tile && it->type == building.type)
+        {
+            blockFootprint(it->tile, it->type, -1);
+            m_reservations.erase(it);
+            break;
+        }
+    }
+}
+
+void MapTools::removeBuilding(BWAPI::Unit unit)
+{
+    const size_t id = (size_t)unit->getID();
+    if (id >= m_buildings.size() || m_buildings[id].type == BWAPI::UnitTypes::None) { return; }
+
+    blockFootprint(m_buildings[id].tile, m_buildings[id].type, -1);
+    m_buildings[id] = Footprint();
+}
+
+// keeps other placements off a footprint between sending a worker there and the building appearing
+void MapTools::reserveBuildLocation(const BWAPI::UnitType & type, const BWAPI::TilePosition & tile)
+{
+    m_reservations.push_back({ tile, type, m_frame });
+    blockFootprint(tile, type, 1);
+}
+
+void MapTools::expireReservations()
+{
+    for (size_t i = 0; i < m_reservations.size();)
+    {
+        if (m_frame - m_reservations[i].frame < ReservationFrames) { ++i; continue; }
+
+        blockFootprint(m_reservations[i].tile, m_reservations[i].type, -1);
+        m_reservations[i] = m_reservations.back();
+        m_reservations.pop_back();
+    }
+}
+
+void MapTools::blockFootprint(const BWAPI::TilePosition & tile, const BWAPI::UnitType & type, int delta)
+{
+    const int x0 = std::max(0, tile.x);
+    const int y0 = std::max(0, tile.y);
+    const int x1 = std::min(m_width, tile.x + type.tileWidth());
+    const int y1 = std::min(m_height, tile.y + type.tileHeight());
+    if (x0 >= x1 || y0 >= y1) { return; }
+
+    for (int y = y0; y < y1; ++y)
+    {
+        const auto row = m_blocked.row(y);
+        for (int x = x0; x < x1; ++x)
+        {
+            row[x] = (uint8_t)(row[x] + delta);
+        }
+    }
+
+    updatePlacementSums(x0, y0);
+    ++m_placementVersion;
+}
+
+// Rebuilds the summed-area tables below and to the right of (fromX, fromY), the only part of
+// them that a change to that tile can affect. Entry (x+1, y+1) holds the number of free tiles
+// in the rectangle from (0, 0) to (x, y).
+void MapTools::updatePlacementSums(int fromX, int fromY)
+{
+    for (int y = fromY; y < m_height; ++y)
+    {
+        const auto above      = m_freeSum.row(y);
+        const auto row        = m_freeSum.row(y + 1);
+        const auto depotAbove = m_depotFreeSum.row(y);
+        const auto depotRow   = m_depotFreeSum.row(y + 1);
+        const auto blocked    = m_blocked.row(y);
+
+        for (int x = fromX; x < m_width; ++x)
+        {
+            const bool open = blocked[x] == 0;
+            row[x + 1]      = (open && m_buildable.get(x, y)) + row[x] + above[x + 1] - above[x];
+            depotRow[x + 1] = (open && m_depotBuildable.get(x, y)) + depotRow[x] + depotAbove[x + 1] - depotAbove[x];
+        }
+    }
+}
+
+// whether every tile in the rectangle is buildable and free of buildings and reservations
+bool MapTools::isFootprintFree(int tileX, int tileY, int width, int height) const
+{
+    return RectFree(m_freeSum, tileX, tileY, width, height);
+}
+
+// Whether a building of this type fits with its top left corner on tile, in O(1). Depots use
+// the depot buildable layer, and buildings that can take an addon also need its 2x2 spot free.
+// Only terrain and buildings are considered: units standing there, creep and psi are not.
+bool MapTools::canPlace(const BWAPI::UnitType & type, const BWAPI::TilePosition & tile) const
+{
+    const int w = type.tileWidth();
+    const int h = type.tileHeight();
+
+    if (!RectFree(type.isResourceDepot() ? m_depotFreeSum : m_freeSum, tile.x, tile.y, w, h)) { return false; }
+    if (type.canBuildAddon() && !RectFree(m_freeSum, tile.x + w, tile.y + h - 2, 2, 2)) { return false; }
+
+    return true;
+}
+
+// The closest top left tile to seed, by rings of growing chessboard distance, where canPlace
+// holds. Returns TilePositions::None if nothing fits within maxRadius tiles.
+BWAPI::TilePosition MapTools::getBuildLocation(const BWAPI::UnitType & type, const BWAPI::TilePosition & seed, int maxRadius) const
+{
+    if (canPlace(type, seed)) { return seed; }
+
+    for (int r = 1; r <= maxRadius; ++r)
+    {
+        for (int dy = -r; dy <= r; ++dy)
+        {
+            // the top and bottom rows of a ring are full, the rows in between only have their ends
+            const int step = (dy == -r || dy == r) ? 1 : 2 * r;
+            for (int dx = -r; dx <= r; dx += step)
+            {
+                const BWAPI::TilePosition tile(seed.x + dx, seed.y + dy);
+                if (canPlace(type, tile)) { return tile; }
+            }
+        }
+    }
+
+    return BWAPI::TilePositions::None;
+}
+
 // saves the map to a file in the StarDraft map format
 // https://github.com/davechurchill/stardraft/wiki/Map-File-Syntax
 void MapTools::saveMapToFile(const std::string& str) const
@@ -183,35 +825,35 @@ void MapTools::saveMapToFile(const std::string& str) const
         path = "replaydata/maps/" + m_mapName + ".txt";
     }
 
-    std::ofstream fout(path);
-
-    // print the width and height of the map
-    fout << width() << " " << height() << "\n";
-
-    // print all the possible starting locations
-    fout << BWAPI::Broodwar->getStartLocations().size();
-    for (auto tile : BWAPI::Broodwar->getStartLocations())
-    {
-        fout << " " << tile.x << " " << tile.y;
-    }   fout << "\n";
+    getMapFile().saveText(path);
+}
 
-    // print the character of the type of tile this is
-    for (size_t y = 0; y < height(); y++)
+// saves the map to a run-length encoded binary file that MapFile::load can read back
+void MapTools::saveMapToBinaryFile(const std::string& str) const
+{
+    std::string path = str;
+    if (path.length() == 0)
     {
-        for (size_t x = 0; x < width(); x++)
-        {
-            fout << m_tileType.get(x, y);
-        }   fout << "\n";
+        path = "replaydata/maps/" + m_mapName + ".bin";
     }
 
-    // print out the walk tiles
-    for (size_t y = 0; y < height()*4; y++)
+    getMapFile().saveBinary(path);
+}
+
+MapFile MapTools::getMapFile() const
+{
+    MapFile map;
+    map.width     = m_width;
+    map.height    = m_height;
+    map.tileTypes = m_tileType;
+    map.walkTiles = m_walkTiles;
+
+    for (auto tile : BWAPI::Broodwar->getStartLocations())
     {
-        for (size_t x = 0; x < width()*4; x++)
-        {
-            fout << BWAPI::Broodwar->isWalkable((int)x, (int)y) ? '0' : '1';
-        }   fout << "\n";
+        map.startLocations.emplace_back(tile.x, tile.y);
     }
+
+    return map;
 }
 
 void MapTools::printMap() const
@@ -257,6 +899,71 @@ bool MapTools::isWalkable(const BWAPI::TilePosition & tile) const
     return isWalkable(tile.x, tile.y);
 }
 
+bool MapTools::isFullyWalkable(int tileX, int tileY) const
+{
+    if (!isValidTile(tileX, tileY)) { return false; }
+
+    return m_walkableAll.get(tileX, tileY);
+}
+
+// true if some, but not all, of the 16 walk tiles inside this tile are walkable
+bool MapTools::isPartiallyWalkable(int tileX, int tileY) const
+{
+    if (!isValidTile(tileX, tileY)) { return false; }
+
+    return m_walkableAny.get(tileX, tileY) && !m_walkableAll.get(tileX, tileY);
+}
+
+bool MapTools::isValidWalkTile(int walkX, int walkY) const
+{
+    return walkX >= 0 && walkY >= 0 && walkX < m_width*4 && walkY < m_height*4;
+}
+
+bool MapTools::isWalkTileWalkable(int walkX, int walkY) const
+{
+    if (!isValidWalkTile(walkX, walkY)) { return false; }
+
+    return m_walkTiles.get(walkX, walkY);
+}
+
+bool MapTools::isWalkTileWalkable(const BWAPI::WalkPosition & walk) const
+{
+    return isWalkTileWalkable(walk.x, walk.y);
+}
+
+const Grid<bool>& MapTools::walkTiles() const
+{
+    return m_walkTiles;
+}
+
+// distance in walk tiles from this walk tile to the closest unwalkable one, 0 if it's unwalkable
+int MapTools::getClearance(int walkX, int walkY) const
+{
+    if (!isValidWalkTile(walkX, walkY)) { return 0; }
+
+    return m_clearance.get(walkX, walkY);
+}
+
+int MapTools::getClearance(const BWAPI::WalkPosition & walk) const
+{
+    return getClearance(walk.x, walk.y);
+}
+
+// whether a unit of this type centered at pos would only stand on walkable walk tiles
+// the unit's box is rounded up to a square, so this errs on the side of 'doesn't fit'
+bool MapTools::canFit(const BWAPI::UnitType & type, const BWAPI::Position & pos) const
+{
+    const int halfExtent = std::max({ type.dimensionLeft(), type.dimensionRight(), type.dimensionUp(), type.dimensionDown() });
+    const int walkRadius = (halfExtent + 7) / 8;
+
+    return getClearance(BWAPI::WalkPosition(pos)) > walkRadius;
+}
+
+const Grid<uint16_t>& MapTools::clearance() const
+{
+    return m_clearance;
+}
+
 int MapTools::width() const
 {
     return m_width;
@@ -280,58 +987,113 @@ void MapTools::drawTile(int tileX, int tileY, const BWAPI::Color & color) const
     BWAPI::Broodwar->drawLineMap(px,     py + d, px,     py,     color);
 }
 
-bool MapTools::canWalk(int tileX, int tileY) const
+namespace
 {
-    for (int i=0; i<4; ++i)
+    // colors of the tile states draw() shows, index 0 means the tile isn't drawn
+    const BWAPI::Color TileColors[] =
     {
-        for (int j=0; j<4; ++j)
-        {
-            if (!BWAPI::Broodwar->isWalkable(tileX*4 + i, tileY*4 + j))
-            {
-                return false;
-            }
-        }
-    }
-
-    return true;
+        BWAPI::Colors::Black,
+        BWAPI::Color(255, 0, 0),        // can't walk or build
+        BWAPI::Color(0, 255, 0),        // can walk and build
+        BWAPI::Color(255, 255, 0),      // walkable but not buildable
+        BWAPI::Color(127, 255, 255),    // buildable but not for a depot
+        BWAPI::Color(127, 127, 127)     // buildable but taken by a building or a reservation
+    };
 }
 
-bool MapTools::canBuild(int tileX, int tileY) const
+int MapTools::tileColor(int tileX, int tileY) const
 {
-    return BWAPI::Broodwar->isBuildable(BWAPI::TilePosition(tileX, tileY));
+    if (!isValidTile(tileX, tileY)) { return 0; }
+
+    if (isBuildable(tileX, tileY) && m_blocked.get(tileX, tileY) > 0) { return 5; }
+    if (isBuildable(tileX, tileY) && !isDepotBuildableTile(tileX, tileY)) { return 4; }
+    if (isWalkable(tileX, tileY) && !isBuildable(tileX, tileY)) { return 3; }
+    return isWalkable(tileX, tileY) ? 2 : 1;
 }
 
-void MapTools::draw() const
+// Merges the tiles in view into as few boxes as possible: each row is split into runs of the
+// same color, and a run that spans exactly the same columns as one in the row above extends it
+// downward instead of starting a new box. One box outline then stands in for the four lines
+// per tile that used to be drawn.
+void MapTools::buildDrawCache(const BWAPI::TilePosition & screen) const
 {
-    const BWAPI::TilePosition screen(BWAPI::Broodwar->getScreenPosition());
-    const int sx = screen.x;
-    const int sy = screen.y;
-    const int ex = sx + 20;
-    const int ey = sy + 15;
+    struct Run { int x0, x1, y0, color; };
+
+    m_drawCache.clear();
+    m_drawCacheScreen  = screen;
+    m_drawCacheVersion = m_placementVersion;
 
-    for (int x = sx; x < ex; ++x)
+    const int padding = 2;
+    auto emit = [&](const Run & run, int y1)
     {
-        for (int y = sy; y < ey; y++)
+        if (run.color == 0) { return; }
+        m_drawCache.push_back({ DebugOverlay::Shape::Type::Box, run.x0 * 32 + padding, run.y0 * 32 + padding,
+                                (run.x1 + 1) * 32 - padding, (y1 + 1) * 32 - padding, TileColors[run.color], false });
+    };
+
+    // one extra row and column for the tiles the viewport only partly covers
+    const int sx = std::max(0, screen.x);
+    const int sy = std::max(0, screen.y);
+    const int ex = std::min(m_width, screen.x + 21);
+    const int ey = std::min(m_height, screen.y + 16);
+
+    std::vector<Run>  open;
+    std::vector<Run>  next;
+    std::vector<bool> extended;
+
+    for (int y = sy; y < ey; ++y)
+    {
+        next.clear();
+        extended.assign(open.size(), false);
+
+        for (int x = sx; x < ex;)
         {
-            const BWAPI::TilePosition tilePos(x,y);
-            if (!tilePos.isValid()) { continue; }
+            const int color = tileColor(x, y);
+            int x1 = x;
+            while (x1 + 1 < ex && tileColor(x1 + 1, y) == color) { ++x1; }
 
-            if (true)
+            Run run = { x, x1, y, color };
+            for (size_t i = 0; i < open.size(); ++i)
             {
-                BWAPI::Color color = isWalkable(x, y) ? BWAPI::Color(0, 255, 0) : BWAPI::Color(255, 0, 0);
-                if (isWalkable(x, y) && !isBuildable(x, y)) { color = BWAPI::Color(255, 255, 0); }
-                if (isBuildable(x, y) && !isDepotBuildableTile(x, y)) { color = BWAPI::Color(127, 255, 255); }
-                drawTile(x, y, color);
+                if (open[i].x0 == x && open[i].x1 == x1 && open[i].color == color)
+                {
+                    run.y0 = open[i].y0;
+                    extended[i] = true;
+                    break;
+                }
             }
+
+            next.push_back(run);
+            x = x1 + 1;
+        }
+
+        for (size_t i = 0; i < open.size(); ++i)
+        {
+            if (!extended[i]) { emit(open[i], y - 1); }
         }
+
+        std::swap(open, next);
+    }
+
+    for (auto & run : open) { emit(run, ey - 1); }
+}
+
+void MapTools::draw() const
+{
+    const BWAPI::TilePosition screen(BWAPI::Broodwar->getScreenPosition());
+    if (screen != m_drawCacheScreen || m_placementVersion != m_drawCacheVersion)
+    {
+        buildDrawCache(screen);
     }
 
+    DebugOverlay::getInstance()->draw(m_drawCache);
+
     const char red = '\x08';
     const char green = '\x07';
     const char white = '\x04';
     const char yellow = '\x03';
 
-    BWAPI::Broodwar->drawBoxScreen(0, 0, 200, 100, BWAPI::Colors::Black, true);
+    BWAPI::Broodwar->drawBoxScreen(0, 0, 200, 115, BWAPI::Colors::Black, true);
     BWAPI::Broodwar->setTextSize(BWAPI::Text::Size::Huge);
     BWAPI::Broodwar->drawTextScreen(10, 5, "%cMap Legend", white);
     BWAPI::Broodwar->setTextSize(BWAPI::Text::Size::Default);
@@ -343,6 +1105,8 @@ void MapTools::draw() const
     BWAPI::Broodwar->drawTextScreen(60, 60, "%cResource Tile, Can't Build", white);
     BWAPI::Broodwar->drawTextScreen(10, 75, "Teal:");
     BWAPI::Broodwar->drawTextScreen(60, 75, "%cCan't Build Depot", white);
+    BWAPI::Broodwar->drawTextScreen(10, 90, "Gray:");
+    BWAPI::Broodwar->drawTextScreen(60, 90, "%cBuilding or Reserved", white);
 
     
 }
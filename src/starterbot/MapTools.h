@@ -1,26 +1,84 @@
 #pragma once
 
 #include "Grid.hpp"
+#include "PathFinder.h"
+#include "MapFile.h"
+#include "DebugOverlay.h"
 
 #include <BWAPI.h>
 #include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
 
 class MapTools
 {
     std::string m_mapName;
-    Grid<int>   m_walkable;       // whether a tile is buildable (includes static resources)          
-    Grid<int>   m_buildable;      // whether a tile is buildable (includes static resources)
-    Grid<int>   m_depotBuildable; // whether a depot is buildable on a tile (illegal within 3 tiles of static resource)
+    Grid<bool>  m_walkable;       // whether a tile is walkable (includes static resources)
+    Grid<bool>  m_walkableAll;    // whether all 16 walk tiles inside a tile are walkable
+    Grid<bool>  m_walkableAny;    // whether at least one walk tile inside a tile is walkable
+    Grid<bool>  m_walkTiles;      // walkability at walk tile (8x8 pixel) resolution
+    Grid<uint16_t> m_clearance;   // walk tile distance to the nearest unwalkable walk tile (0 = unwalkable)
+    Grid<bool>  m_buildable;      // whether a tile is buildable (includes static resources)
+    Grid<bool>  m_depotBuildable; // whether a depot is buildable on a tile (illegal within 3 tiles of static resource)
     Grid<int>   m_lastSeen;       // the last time any of our units has seen this position on the map
+    Grid<bool>  m_visible;        // whether a tile was visible as of the last onFrame
     Grid<char>  m_tileType;       // StarDraft tile type
+    Grid<uint8_t> m_blocked;      // number of buildings and build reservations covering a tile
+    Grid<int>   m_freeSum;        // summed-area table of buildable tiles that nothing blocks
+    Grid<int>   m_depotFreeSum;   // summed-area table of depot buildable tiles that nothing blocks
     int         m_width = 0;
     int         m_height = 0;
     int         m_frame = 0;
     bool        m_drawMap = false;
 
-    bool canBuild(int tileX, int tileY) const;
-    bool canWalk(int tileX, int tileY) const;
+    // ground distance fields, most recently used at the front, evicted from the back when
+    // the memory they take would go over m_distanceFieldBudget bytes
+    using DistanceField = std::pair<int, Grid<int>>;
+    mutable std::list<DistanceField> m_distanceFields;
+    mutable std::unordered_map<int, std::list<DistanceField>::iterator> m_distanceFieldIndex;
+    mutable std::vector<int> m_bfsQueue;
+    Grid<int>   m_unreachableField;   // all -1, what getDistanceField returns for a tile off the map
+    size_t  m_distanceFieldBudget = 32 * 1024 * 1024;
+
+    PathFinder  m_pathFinder;     // jump point search over m_walkable
+
+    // buildings currently stamped into m_blocked, indexed by unit id, and footprints we have
+    // sent a worker to build on that don't have a building yet
+    struct Footprint
+    {
+        BWAPI::TilePosition tile = BWAPI::TilePositions::None;
+        BWAPI::UnitType     type = BWAPI::UnitTypes::None;
+        int                 frame = 0;
+    };
+    std::vector<Footprint> m_buildings;
+    std::vector<Footprint> m_reservations;
+    int         m_placementVersion = 0; // bumped whenever m_blocked changes
+
+    // boxes draw() last built for the tiles in view, rebuilt when the view or m_blocked changes
+    mutable DebugOverlay::ShapeList m_drawCache;
+    mutable BWAPI::TilePosition     m_drawCacheScreen = BWAPI::TilePositions::None;
+    mutable int                     m_drawCacheVersion = -1;
+
+    std::vector<unsigned char>       m_prevVisible;       // copy of GameData::isVisible from the previous frame
+    std::vector<BWAPI::TilePosition> m_visibilityChanges; // tiles whose visibility flipped this frame
+
     void printMap() const;
+    void allocateStaticLayers();
+    void computeStaticLayers();
+    void computeClearance();
+    std::vector<std::pair<unsigned char *, size_t>> staticLayerBytes();
+    std::string getCachePath() const;
+    bool loadCache(const std::string & path);
+    void saveCache(const std::string & path);
+    void updateVisibility();
+    void blockFootprint(const BWAPI::TilePosition & tile, const BWAPI::UnitType & type, int delta);
+    void updatePlacementSums(int fromX, int fromY);
+    void expireReservations();
+    int  tileColor(int tileX, int tileY) const;
+    void buildDrawCache(const BWAPI::TilePosition & screen) const;
+    void onVisibilityChanged(int tileX, int tileY, bool visible);
+    void computeDistanceField(const BWAPI::TilePosition & target, Grid<int> & dist) const;
     std::string fixMapName(const std::string& s) const;
 
 public:
@@ -28,10 +86,17 @@ public:
     MapTools();
 
     void    onStart();
+    // frame counter, visibility diff and build reservations; must run every frame, or lastSeen
+    // and getVisibilityChanges fall behind
     void    onFrame();
+
+    // the map overlay, if toggled on; this part can skip frames
+    void    onDraw() const;
     void    draw() const;
     void    toggleDraw();
     void    saveMapToFile(const std::string& str = "") const;
+    void    saveMapToBinaryFile(const std::string& str = "") const;
+    MapFile getMapFile() const;
     const std::string& mapName() const;
 
     int     width() const;
@@ -45,10 +110,34 @@ public:
     bool    isExplored(const BWAPI::Position & pos) const;
     bool    isExplored(const BWAPI::TilePosition & pos) const;
     bool    isVisible(int tileX, int tileY) const;
+    int     lastSeen(int tileX, int tileY) const;
+    const std::vector<BWAPI::TilePosition>& getVisibilityChanges() const;
     bool    isWalkable(int tileX, int tileY) const;
     bool    isWalkable(const BWAPI::TilePosition& tile) const;
+    bool    isFullyWalkable(int tileX, int tileY) const;
+    bool    isPartiallyWalkable(int tileX, int tileY) const;
+    bool    isValidWalkTile(int walkX, int walkY) const;
+    bool    isWalkTileWalkable(int walkX, int walkY) const;
+    bool    isWalkTileWalkable(const BWAPI::WalkPosition & walk) const;
+    const Grid<bool>& walkTiles() const;
+    int     getClearance(int walkX, int walkY) const;
+    int     getClearance(const BWAPI::WalkPosition & walk) const;
+    bool    canFit(const BWAPI::UnitType & type, const BWAPI::Position & pos) const;
+    const Grid<uint16_t>& clearance() const;
+    const Grid<int>& getDistanceField(const BWAPI::TilePosition & target) const;
+    int     getGroundDistance(const BWAPI::TilePosition & from, const BWAPI::TilePosition & to) const;
+    int     getGroundDistance(const BWAPI::Position & from, const BWAPI::Position & to) const;
+    void    setDistanceFieldBudget(size_t bytes);
+    bool    findPath(const BWAPI::TilePosition & start, const BWAPI::TilePosition & goal, std::vector<BWAPI::TilePosition> & path);
+    void    findPaths(const std::vector<std::pair<BWAPI::TilePosition, BWAPI::TilePosition>> & requests, std::vector<std::vector<BWAPI::TilePosition>> & paths);
     bool    isBuildable(int tileX, int tileY) const;
     bool    isBuildable(const BWAPI::TilePosition& tile) const;
     bool    isDepotBuildableTile(int tileX, int tileY) const;
+    void    addBuilding(BWAPI::Unit unit);
+    void    removeBuilding(BWAPI::Unit unit);
+    void    reserveBuildLocation(const BWAPI::UnitType & type, const BWAPI::TilePosition & tile);
+    bool    isFootprintFree(int tileX, int tileY, int width, int height) const;
+    bool    canPlace(const BWAPI::UnitType & type, const BWAPI::TilePosition & tile) const;
+    BWAPI::TilePosition getBuildLocation(const BWAPI::UnitType & type, const BWAPI::TilePosition & seed, int maxRadius = 32) const;
     void    drawTile(int tileX, int tileY, const BWAPI::Color & color) const;
 };
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file, unmapped when the object goes away.
+// Used to load cached map data without reading it through a stream first.
+class MappedFile
+{
+    const unsigned char *   m_data = nullptr;
+    size_t                  m_size = 0;
+    void *                  m_file = nullptr;
+    void *                  m_mapping = nullptr;
+
+public:
+
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    void operator=(const MappedFile &) = delete;
+
+    bool open(const std::string & path);
+    void close();
+
+    const unsigned char *   data() const;
+    size_t                  size() const;
+};
@@ -0,0 +1,214 @@
+#include "MineralIndex.h"
+#include "TerrainAnalyzer.h"
+#include "WorkerRegistry.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+namespace
+{
+    // a depot further than this from a base's depot spot doesn't mine it
+    const int MaxDepotOffset = 10 * 32;
+}
+
+MineralIndex* MineralIndex::instance = nullptr;
+
+MineralIndex* MineralIndex::getInstance()
+{
+    if (instance == nullptr) {
+        instance = new MineralIndex();
+    }
+    return instance;
+}
+
+void MineralIndex::onStart(const TerrainAnalyzer & terrain)
+{
+    m_patches.clear();
+    m_bases.clear();
+    m_activeBases.clear();
+    m_patchOfId.assign(WorkerRegistry::MaxUnitId, -1);
+
+    for (auto & location : terrain.getBaseLocations())
+    {
+        Base base;
+        base.depotCenter = location.depotCenter;
+
+        std::vector<BWAPI::Unit> minerals = location.minerals;
+        std::sort(minerals.begin(), minerals.end(), [&location](BWAPI::Unit a, BWAPI::Unit b)
+        {
+            return location.depotCenter.getApproxDistance(a->getInitialPosition()) < location.depotCenter.getApproxDistance(b->getInitialPosition());
+        });
+        if (minerals.size() > MaxPatchesPerBase) { minerals.resize(MaxPatchesPerBase); }
+
+        for (auto & mineral : minerals)
+        {
+            const int id = mineral->getID();
+            if (id < 0 || id >= WorkerRegistry::MaxUnitId) { continue; }
+
+            Patch patch;
+            patch.unit = mineral;
+            patch.base = (int)m_bases.size();
+            patch.bit  = (int)base.patches.size();
+
+            m_patchOfId[id] = (int)m_patches.size();
+            base.patches.push_back((int)m_patches.size());
+            base.levels[0] |= uint64_t(1) << patch.bit;
+            m_patches.push_back(patch);
+        }
+
+        m_bases.push_back(base);
+    }
+
+    for (auto & unit : BWAPI::Broodwar->self()->getUnits())
+    {
+        if (unit->isCompleted()) { onUnitComplete(unit); }
+    }
+}
+
+int MineralIndex::patchIndex(BWAPI::Unit unit) const
+{
+    if (!unit) { return -1; }
+
+    const int id = unit->getID();
+    return (id >= 0 && id < (int)m_patchOfId.size()) ? m_patchOfId[id] : -1;
+}
+
+int MineralIndex::baseOfDepot(BWAPI::Unit depot) const
+{
+    int closest = -1;
+    int closestDistance = MaxDepotOffset;
+
+    for (size_t i = 0; i < m_bases.size(); ++i)
+    {
+        const int distance = depot->getPosition().getApproxDistance(m_bases[i].depotCenter);
+        if (distance <= closestDistance)
+        {
+            closest = (int)i;
+            closestDistance = distance;
+        }
+    }
+
+    return closest;
+}
+
+void MineralIndex::setWorkers(Patch & patch, int workers)
+{
+    Base & base = m_bases[patch.base];
+    const uint64_t bit = uint64_t(1) << patch.bit;
+
+    base.levels[level(patch.workers)] &= ~bit;
+    base.levels[level(workers)] |= bit;
+    patch.workers = workers;
+}
+
+// SaturatedWorkers + 1 if the base has no patches left
+int MineralIndex::lowestLevel(const Base & base) const
+{
+    for (int l = 0; l <= SaturatedWorkers; ++l)
+    {
+        if (base.levels[l]) { return l; }
+    }
+    return SaturatedWorkers + 1;
+}
+
+void MineralIndex::onUnitComplete(BWAPI::Unit unit)
+{
+    if (unit->getPlayer() != BWAPI::Broodwar->self() || !unit->getType().isResourceDepot()) { return; }
+
+    const int b = baseOfDepot(unit);
+    if (b < 0) { return; }
+
+    // a hatchery turning into a lair must not count twice
+    std::vector<BWAPI::Unit> & depots = m_bases[b].depots;
+    if (std::find(depots.begin(), depots.end(), unit) != depots.end()) { return; }
+
+    depots.push_back(unit);
+    if (depots.size() == 1) { m_activeBases.push_back(b); }
+}
+
+void MineralIndex::onUnitDestroy(BWAPI::Unit unit)
+{
+    // a patch mined out: it stops being handed out, the workers on it are the caller's to move
+    const int p = patchIndex(unit);
+    if (p >= 0)
+    {
+        Patch & patch = m_patches[p];
+        m_bases[patch.base].levels[level(patch.workers)] &= ~(uint64_t(1) << patch.bit);
+        patch.workers = 0;
+        m_patchOfId[unit->getID()] = -1;
+        return;
+    }
+
+    if (unit->getPlayer() != BWAPI::Broodwar->self() || !unit->getType().isResourceDepot()) { return; }
+
+    const int b = baseOfDepot(unit);
+    if (b < 0) { return; }
+
+    std::vector<BWAPI::Unit> & depots = m_bases[b].depots;
+    const auto it = std::find(depots.begin(), depots.end(), unit);
+    if (it == depots.end()) { return; }
+
+    depots.erase(it);
+    if (depots.empty())
+    {
+        m_activeBases.erase(std::find(m_activeBases.begin(), m_activeBases.end(), b));
+    }
+}
+
+// Patches with 0 or 1 workers are equally good, so the closest base with either wins; past that a
+// base is only picked over a closer one if its patches are less saturated.
+BWAPI::Unit MineralIndex::assign(BWAPI::Position from)
+{
+    int bestBase = -1;
+    int bestTier = std::numeric_limits<int>::max();
+    int bestDistance = std::numeric_limits<int>::max();
+
+    for (int b : m_activeBases)
+    {
+        const int lowest = lowestLevel(m_bases[b]);
+        if (lowest > SaturatedWorkers) { continue; }
+
+        const int tier = std::max(0, lowest - 1);
+        const int distance = from.getApproxDistance(m_bases[b].depotCenter);
+        if (tier < bestTier || (tier == bestTier && distance < bestDistance))
+        {
+            bestBase = b;
+            bestTier = tier;
+            bestDistance = distance;
+        }
+    }
+
+    if (bestBase < 0) { return nullptr; }
+
+    const Base & base = m_bases[bestBase];
+    const int bit = std::countr_zero(base.levels[lowestLevel(base)]);
+    Patch & patch = m_patches[base.patches[bit]];
+
+    setWorkers(patch, patch.workers + 1);
+    return patch.unit;
+}
+
+void MineralIndex::release(BWAPI::Unit patch)
+{
+    const int p = patchIndex(patch);
+    if (p < 0 || m_patches[p].workers == 0) { return; }
+
+    setWorkers(m_patches[p], m_patches[p].workers - 1);
+}
+
+bool MineralIndex::contains(BWAPI::Unit patch) const
+{
+    return patchIndex(patch) >= 0;
+}
+
+int MineralIndex::workersOn(BWAPI::Unit patch) const
+{
+    const int p = patchIndex(patch);
+    return p >= 0 ? m_patches[p].workers : 0;
+}
+
+int MineralIndex::activeBaseCount() const
+{
+    return (int)m_activeBases.size();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <BWAPI.h>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+class TerrainAnalyzer;
+
+// The static mineral patches grouped by base, with how many of our workers are mining each one.
+// Within a base the patches are numbered by distance to the depot, and for every worker count
+// the base keeps a bitmask of the patches that have it, so the closest least-saturated patch of
+// a base is the lowest set bit of its first non-empty mask. Only bases where we have a finished
+// resource depot hand out patches.
+//
+// Counts change as workers are assigned and released, patches leave the index as they mine out,
+// and bases turn on and off as our depots finish or die.
+class MineralIndex
+{
+public:
+
+    static const int MaxPatchesPerBase = 64;        // one bit each in the level masks
+    static const int SaturatedWorkers = 3;          // counts at or above this share the last level
+
+private:
+
+    static MineralIndex* instance;
+
+    struct Patch
+    {
+        BWAPI::Unit     unit;
+        int             base;
+        int             bit;                        // position in the base, closest to the depot first
+        int             workers = 0;
+    };
+
+    struct Base
+    {
+        BWAPI::Position                                 depotCenter;
+        std::vector<int>                                patches;        // by bit
+        std::array<uint64_t, SaturatedWorkers + 1>      levels{};       // patches with 0, 1, 2, 3+ workers
+        std::vector<BWAPI::Unit>                        depots;         // our finished depots at the base
+    };
+
+    std::vector<Patch>  m_patches;
+    std::vector<Base>   m_bases;
+    std::vector<int>    m_activeBases;
+    std::vector<int>    m_patchOfId;                // -1 if the id is not an indexed patch
+
+    MineralIndex() {}
+
+    static inline int level(int workers) { return workers < SaturatedWorkers ? workers : SaturatedWorkers; }
+
+    int     patchIndex(BWAPI::Unit unit) const;
+    int     baseOfDepot(BWAPI::Unit depot) const;
+    void    setWorkers(Patch & patch, int workers);
+    int     lowestLevel(const Base & base) const;
+
+public:
+
+    MineralIndex(MineralIndex& other) = delete;
+    void operator=(const MineralIndex&) = delete;
+
+    static MineralIndex* getInstance();
+
+    // builds the index from the analyzed bases and turns on the bases where we have a depot
+    void    onStart(const TerrainAnalyzer & terrain);
+    void    onUnitComplete(BWAPI::Unit unit);
+    void    onUnitDestroy(BWAPI::Unit unit);
+
+    // the least saturated patch of the closest base that has one, preferring bases with a patch
+    // under two workers; counts the worker on it. nullptr if no base of ours has minerals left.
+    BWAPI::Unit assign(BWAPI::Position from);
+
+    // a worker stopped mining the patch; does nothing if the patch is not indexed
+    void    release(BWAPI::Unit patch);
+
+    bool    contains(BWAPI::Unit patch) const;
+    int     workersOn(BWAPI::Unit patch) const;
+    int     activeBaseCount() const;
+};
@@ -0,0 +1,251 @@
+#include "PathFinder.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    const int StraightCost = 10;
+    const int DiagonalCost = 14;
+
+    // octile distance: as many diagonal steps as possible, then straight
+    int OctileDistance(int dx, int dy)
+    {
+        dx = std::abs(dx);
+        dy = std::abs(dy);
+        return DiagonalCost * std::min(dx, dy) + StraightCost * (std::max(dx, dy) - std::min(dx, dy));
+    }
+
+    int Sign(int v)
+    {
+        return (v > 0) - (v < 0);
+    }
+
+    // min-heap on f, ties go to the node furthest from the start
+    struct OpenNodeGreater
+    {
+        template <class T>
+        bool operator () (const T & a, const T & b) const
+        {
+            return a.f > b.f || (a.f == b.f && a.g < b.g);
+        }
+    };
+}
+
+PathFinder::PathFinder()
+{
+
+}
+
+void PathFinder::init(const Grid<bool> & walkable)
+{
+    m_walkable = &walkable;
+    m_width    = (int)walkable.width();
+    m_height   = (int)walkable.height();
+    m_search   = 0;
+
+    const size_t tiles = (size_t)m_width * m_height;
+    m_g.assign(tiles, 0);
+    m_parent.assign(tiles, -1);
+    m_seen.assign(tiles, 0);
+    m_closed.assign(tiles, 0);
+    m_open.clear();
+    m_open.reserve(tiles);
+    m_neighbors.reserve(8);
+}
+
+int PathFinder::heuristic(int index) const
+{
+    return OctileDistance(index % m_width - m_goal % m_width, index / m_width - m_goal / m_width);
+}
+
+// Walks from (x, y) in direction (dx, dy) until it finds a tile that needs to be expanded:
+// the goal, a tile with a forced neighbor, or for diagonal moves a tile from which one of the
+// two straight scans finds a jump point. Returns the tile index, or -1 if it hit a wall.
+int PathFinder::jump(int x, int y, int dx, int dy) const
+{
+    while (true)
+    {
+        if (!walkable(x, y)) { return -1; }
+
+        const int index = y * m_width + x;
+        if (index == m_goal) { return index; }
+
+        if (dx != 0 && dy != 0)
+        {
+            if (jump(x + dx, y, dx, 0) != -1 || jump(x, y + dy, 0, dy) != -1) { return index; }
+        }
+        else if (dx != 0)
+        {
+            if ((walkable(x, y - 1) && !walkable(x - dx, y - 1)) ||
+                (walkable(x, y + 1) && !walkable(x - dx, y + 1))) { return index; }
+        }
+        else
+        {
+            if ((walkable(x - 1, y) && !walkable(x - 1, y - dy)) ||
+                (walkable(x + 1, y) && !walkable(x + 1, y - dy))) { return index; }
+        }
+
+        // no corner cutting: both sides of a diagonal step must be open
+        if (!walkable(x + dx, y) || !walkable(x, y + dy)) { return -1; }
+
+        x += dx;
+        y += dy;
+    }
+}
+
+// Collects the tiles worth jumping towards from this one, pruned by the direction we came from
+void PathFinder::findNeighbors(int index)
+{
+    m_neighbors.clear();
+
+    const int x = index % m_width;
+    const int y = index / m_width;
+    const int parent = m_parent[index];
+
+    if (parent == -1)
+    {
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                if ((dx == 0 && dy == 0) || !walkable(x + dx, y + dy)) { continue; }
+                if (dx != 0 && dy != 0 && (!walkable(x + dx, y) || !walkable(x, y + dy))) { continue; }
+                m_neighbors.push_back((y + dy) * m_width + (x + dx));
+            }
+        }
+        return;
+    }
+
+    const int dx = Sign(x - parent % m_width);
+    const int dy = Sign(y - parent / m_width);
+    auto add = [&](int nx, int ny) { m_neighbors.push_back(ny * m_width + nx); };
+
+    if (dx != 0 && dy != 0)
+    {
+        const bool vertical   = walkable(x, y + dy);
+        const bool horizontal = walkable(x + dx, y);
+        if (vertical)               { add(x, y + dy); }
+        if (horizontal)             { add(x + dx, y); }
+        if (vertical && horizontal) { add(x + dx, y + dy); }
+    }
+    else if (dx != 0)
+    {
+        const bool next   = walkable(x + dx, y);
+        const bool top    = walkable(x, y - 1);
+        const bool bottom = walkable(x, y + 1);
+        if (next)           { add(x + dx, y); }
+        if (next && top)    { add(x + dx, y - 1); }
+        if (next && bottom) { add(x + dx, y + 1); }
+        if (top)            { add(x, y - 1); }
+        if (bottom)         { add(x, y + 1); }
+    }
+    else
+    {
+        const bool next  = walkable(x, y + dy);
+        const bool left  = walkable(x - 1, y);
+        const bool right = walkable(x + 1, y);
+        if (next)          { add(x, y + dy); }
+        if (next && left)  { add(x - 1, y + dy); }
+        if (next && right) { add(x + 1, y + dy); }
+        if (left)          { add(x - 1, y); }
+        if (right)         { add(x + 1, y); }
+    }
+}
+
+void PathFinder::push(int index, int g, int parent)
+{
+    if (m_seen[index] == m_search && m_g[index] <= g) { return; }
+
+    m_seen[index]   = m_search;
+    m_g[index]      = g;
+    m_parent[index] = parent;
+
+    m_open.push_back({ g + heuristic(index), g, index });
+    std::push_heap(m_open.begin(), m_open.end(), OpenNodeGreater());
+}
+
+bool PathFinder::search(int start, int goal)
+{
+    // a new id invalidates every tile stamped by earlier searches, only on wrap do we clear
+    if (++m_search == 0)
+    {
+        std::fill(m_seen.begin(), m_seen.end(), 0);
+        std::fill(m_closed.begin(), m_closed.end(), 0);
+        m_search = 1;
+    }
+
+    m_goal = goal;
+    m_open.clear();
+    push(start, 0, -1);
+
+    while (!m_open.empty())
+    {
+        std::pop_heap(m_open.begin(), m_open.end(), OpenNodeGreater());
+        const OpenNode node = m_open.back();
+        m_open.pop_back();
+
+        if (m_closed[node.index] == m_search) { continue; }
+        m_closed[node.index] = m_search;
+
+        if (node.index == goal) { return true; }
+
+        findNeighbors(node.index);
+        const int x = node.index % m_width;
+        const int y = node.index / m_width;
+
+        for (int neighbor : m_neighbors)
+        {
+            const int nx = neighbor % m_width;
+            const int ny = neighbor / m_width;
+            const int jumpPoint = jump(nx, ny, nx - x, ny - y);
+            if (jumpPoint == -1 || m_closed[jumpPoint] == m_search) { continue; }
+
+            const int g = node.g + OctileDistance(jumpPoint % m_width - x, jumpPoint / m_width - y);
+            push(jumpPoint, g, node.index);
+        }
+    }
+
+    return false;
+}
+
+bool PathFinder::findPath(const BWAPI::TilePosition & start, const BWAPI::TilePosition & goal, std::vector<BWAPI::TilePosition> & path)
+{
+    path.clear();
+
+    if (!m_walkable) { return false; }
+    if (start.x < 0 || start.y < 0 || start.x >= m_width || start.y >= m_height) { return false; }
+    if (!walkable(goal.x, goal.y)) { return false; }
+
+    const int startIndex = start.y * m_width + start.x;
+    const int goalIndex  = goal.y * m_width + goal.x;
+    if (!search(startIndex, goalIndex)) { return false; }
+
+    for (int index = goalIndex; index != -1; index = m_parent[index])
+    {
+        path.emplace_back(index % m_width, index / m_width);
+    }
+
+    std::reverse(path.begin(), path.end());
+    return true;
+}
+
+void PathFinder::findPaths(const std::vector<std::pair<BWAPI::TilePosition, BWAPI::TilePosition>> & requests, std::vector<std::vector<BWAPI::TilePosition>> & paths)
+{
+    paths.resize(requests.size());
+
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        findPath(requests[i].first, requests[i].second, paths[i]);
+    }
+}
+
+int PathFinder::pathCost(const std::vector<BWAPI::TilePosition> & path)
+{
+    int cost = 0;
+    for (size_t i = 1; i < path.size(); ++i)
+    {
+        cost += OctileDistance(path[i].x - path[i - 1].x, path[i].y - path[i - 1].y);
+    }
+    return cost;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Grid.hpp"
+
+#include <BWAPI.h>
+#include <vector>
+#include <utility>
+
+// Jump Point Search over the MapTools walkable tile grid.
+// Units may move in 8 directions but never cut a corner, so a diagonal step needs both of the
+// orthogonal tiles it passes between to be walkable. All per-tile search state lives in arrays
+// allocated once in init() and stamped with a search id, so a search never allocates or clears.
+class PathFinder
+{
+    struct OpenNode
+    {
+        int f;
+        int g;
+        int index;
+    };
+
+    const Grid<bool> *      m_walkable = nullptr;
+    int                     m_width = 0;
+    int                     m_height = 0;
+    int                     m_goal = -1;
+    unsigned int            m_search = 0;
+
+    std::vector<int>            m_g;        // cost from the start, valid if m_seen == m_search
+    std::vector<int>            m_parent;   // tile index we jumped here from
+    std::vector<unsigned int>   m_seen;     // id of the last search that reached this tile
+    std::vector<unsigned int>   m_closed;   // id of the last search that expanded this tile
+    std::vector<OpenNode>       m_open;     // binary heap ordered on f
+    std::vector<int>            m_neighbors;
+
+    inline bool walkable(int x, int y) const
+    {
+        return x >= 0 && y >= 0 && x < m_width && y < m_height && m_walkable->get(x, y);
+    }
+
+    int  heuristic(int index) const;
+    int  jump(int x, int y, int dx, int dy) const;
+    void findNeighbors(int index);
+    void push(int index, int g, int parent);
+    bool search(int start, int goal);
+
+public:
+
+    PathFinder();
+
+    void init(const Grid<bool> & walkable);
+
+    // fills path with the jump points from start to goal, both included, and returns false if
+    // the goal can't be reached. Consecutive points are joined by straight or diagonal lines.
+    bool findPath(const BWAPI::TilePosition & start, const BWAPI::TilePosition & goal, std::vector<BWAPI::TilePosition> & path);
+
+    // plans every (start, goal) pair in one call, reusing the same search storage for all of them
+    // paths[i] is left empty if request i has no path
+    void findPaths(const std::vector<std::pair<BWAPI::TilePosition, BWAPI::TilePosition>> & requests, std::vector<std::vector<BWAPI::TilePosition>> & paths);
+
+    // cost of a path returned by findPath, 10 per straight step and 14 per diagonal step
+    static int pathCost(const std::vector<BWAPI::TilePosition> & path);
+};
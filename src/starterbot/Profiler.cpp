@@ -0,0 +1,236 @@
+#include "Profiler.h"
+
+#if STARTERBOT_PROFILER
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+Profiler* Profiler::instance = nullptr;
+
+Profiler* Profiler::getInstance()
+{
+    if (instance == nullptr) {
+        instance = new Profiler();
+    }
+    return instance;
+}
+
+Profiler::Profiler()
+    : m_ring(RingCapacity)
+    , m_epoch(Clock::now())
+{
+
+}
+
+// Bucket b holds values in [2^(b/4) - 1, 2^((b+1)/4) - 1), so each bucket is about 19% wide
+// whatever the magnitude, and a percentile is reported as the top of its bucket
+void Profiler::Histogram::add(double value)
+{
+    const int bucket = std::clamp((int)(4 * std::log2(std::max(0.0, value) + 1)), 0, HistogramBuckets - 1);
+    ++buckets[bucket];
+    ++frames;
+    sum += value;
+    max = std::max(max, value);
+}
+
+double Profiler::Histogram::percentile(double p) const
+{
+    if (frames == 0) { return 0; }
+
+    const uint64_t rank = (uint64_t)std::ceil(p * frames);
+    uint64_t seen = 0;
+    for (int b = 0; b < HistogramBuckets; ++b)
+    {
+        seen += buckets[b];
+        if (seen >= rank) { return std::min(max, std::exp2((b + 1) / 4.0) - 1); }
+    }
+
+    return max;
+}
+
+int Profiler::nameId(const char * name)
+{
+    const auto it = std::find(m_names.begin(), m_names.end(), name);
+    if (it != m_names.end()) { return (int)(it - m_names.begin()); }
+
+    m_names.push_back(name);
+    return (int)m_names.size() - 1;
+}
+
+// the node for name under parent, made the first time the pair is seen
+int Profiler::child(int parent, int name, bool counter)
+{
+    if (parent >= 0)
+    {
+        for (int c : m_nodes[parent].children)
+        {
+            if (m_nodes[c].name == name) { return c; }
+        }
+    }
+    else
+    {
+        for (int n = 0; n < (int)m_nodes.size(); ++n)
+        {
+            if (m_nodes[n].parent < 0 && m_nodes[n].name == name) { return n; }
+        }
+    }
+
+    Node node;
+    node.name    = name;
+    node.parent  = parent;
+    node.counter = counter;
+    m_nodes.push_back(node);
+
+    const int id = (int)m_nodes.size() - 1;
+    if (parent >= 0) { m_nodes[parent].children.push_back(id); }
+    return id;
+}
+
+void Profiler::record(const Event & event)
+{
+    m_ring[m_ringNext] = event;
+    m_ringNext = (m_ringNext + 1) % RingCapacity;
+    m_ringSize = std::min(m_ringSize + 1, RingCapacity);
+
+    Node & node = m_nodes[event.node];
+    node.frameTotal += event.duration < 0 ? event.value : event.duration;
+    if (!node.touched)
+    {
+        node.touched = true;
+        m_touched.push_back(event.node);
+    }
+}
+
+// adds the totals of the frame that just ended to the histograms
+void Profiler::endFrame()
+{
+    for (int n : m_touched)
+    {
+        m_nodes[n].histogram.add(m_nodes[n].frameTotal);
+        m_nodes[n].frameTotal = 0;
+        m_nodes[n].touched = false;
+    }
+    m_touched.clear();
+}
+
+void Profiler::beginFrame(int frame)
+{
+    if (frame == m_frame) { return; }
+
+    endFrame();
+    m_frame = frame;
+}
+
+void Profiler::enter(int name)
+{
+    const int parent = m_depth > 0 ? m_stack[std::min(m_depth, MaxDepth) - 1] : -1;
+    const int node = child(parent, name, false);
+
+    if (m_depth < MaxDepth) { m_stack[m_depth] = node; }
+    ++m_depth;
+}
+
+void Profiler::leave(Clock::time_point start)
+{
+    const Clock::time_point end = Clock::now();
+    --m_depth;
+    if (m_depth >= MaxDepth) { return; }
+
+    Event event;
+    event.node     = m_stack[m_depth];
+    event.frame    = m_frame;
+    event.start    = std::chrono::duration_cast<std::chrono::microseconds>(start - m_epoch).count();
+    event.duration = (int32_t)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    event.value    = 0;
+    record(event);
+}
+
+void Profiler::count(int name, double value)
+{
+    const int parent = m_depth > 0 ? m_stack[std::min(m_depth, MaxDepth) - 1] : -1;
+
+    Event event;
+    event.node     = child(parent, name, true);
+    event.frame    = m_frame;
+    event.start    = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_epoch).count();
+    event.duration = -1;
+    event.value    = value;
+    record(event);
+}
+
+void Profiler::writeNode(std::ostream & out, int node, int indent) const
+{
+    const Node & n = m_nodes[node];
+    const Histogram & h = n.histogram;
+
+    char line[256];
+    const std::string name = std::string(indent * 2, ' ') + m_names[n.name];
+    if (n.counter)
+    {
+        std::snprintf(line, sizeof(line), "%-40s %8llu %10.1f %10.1f %10.1f %10.1f\n", name.c_str(),
+            (unsigned long long)h.frames, h.frames ? h.sum / h.frames : 0.0, h.percentile(0.5), h.percentile(0.99), h.max);
+    }
+    else
+    {
+        std::snprintf(line, sizeof(line), "%-40s %8llu %10.3f %10.3f %10.3f %10.3f\n", name.c_str(),
+            (unsigned long long)h.frames, h.frames ? h.sum / h.frames / 1000 : 0.0, h.percentile(0.5) / 1000, h.percentile(0.99) / 1000, h.max / 1000);
+    }
+    out << line;
+
+    for (int c : n.children) { writeNode(out, c, indent + 1); }
+}
+
+void Profiler::writeReport(const std::string & path)
+{
+    endFrame();
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    // summary: per-frame totals of every scope in ms, and of every counter in its own unit
+    {
+        std::ofstream out(path + ".txt");
+        if (!out) { return; }
+
+        char header[256];
+        std::snprintf(header, sizeof(header), "%-40s %8s %10s %10s %10s %10s\n", "scope (ms per frame)", "frames", "mean", "p50", "p99", "max");
+        out << header;
+
+        for (int n = 0; n < (int)m_nodes.size(); ++n)
+        {
+            if (m_nodes[n].parent < 0) { writeNode(out, n, 0); }
+        }
+    }
+
+    // trace: the runs still in the ring buffer as complete events, counters as counter events
+    {
+        std::ofstream out(path + ".json");
+        if (!out) { return; }
+
+        out << "{\"traceEvents\":[\n";
+        const size_t first = (m_ringNext + RingCapacity - m_ringSize) % RingCapacity;
+        for (size_t i = 0; i < m_ringSize; ++i)
+        {
+            const Event & e = m_ring[(first + i) % RingCapacity];
+            const std::string & name = m_names[m_nodes[e.node].name];
+
+            out << (i > 0 ? ",\n" : "");
+            if (e.duration < 0)
+            {
+                out << "{\"name\":\"" << name << "\",\"ph\":\"C\",\"ts\":" << e.start
+                    << ",\"pid\":0,\"tid\":0,\"args\":{\"value\":" << e.value << "}}";
+            }
+            else
+            {
+                out << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"ts\":" << e.start << ",\"dur\":" << e.duration
+                    << ",\"pid\":0,\"tid\":0,\"args\":{\"frame\":" << e.frame << "}}";
+            }
+        }
+        out << "\n]}\n";
+    }
+}
+
+#endif
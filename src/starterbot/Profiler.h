@@ -0,0 +1,145 @@
+#pragma once
+
+// Scoped timers and counters for finding out where frame time goes.
+//
+//     PROFILE_FRAME(frame);            start of a new frame, once per onFrame
+//     PROFILE_SCOPE("name");           times the rest of the enclosing block
+//     PROFILE_COUNT("name", value);    adds value to a per-frame counter
+//
+// Scopes nest: a scope opened inside another is recorded as its child, so the same name under
+// two different parents shows up twice in the report. Every scope run goes into a fixed size ring
+// buffer that becomes the Chrome trace (chrome://tracing, or https://ui.perfetto.dev), and every
+// scope and counter keeps a histogram of its per-frame totals for the p50/p99/max summary.
+//
+// Building with STARTERBOT_PROFILER=0 turns the macros into nothing.
+#ifndef STARTERBOT_PROFILER
+#define STARTERBOT_PROFILER 1
+#endif
+
+#if STARTERBOT_PROFILER
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class Profiler
+{
+public:
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    static const size_t RingCapacity = 1 << 16;     // scope runs kept for the trace
+    static const int    MaxDepth = 32;
+    static const int    HistogramBuckets = 128;     // 4 per power of two
+
+    // per-frame totals of one scope or counter; values are microseconds for scopes
+    struct Histogram
+    {
+        std::array<uint32_t, HistogramBuckets> buckets{};
+        uint64_t    frames = 0;
+        double      sum = 0;
+        double      max = 0;
+
+        void        add(double value);
+        double      percentile(double p) const;
+    };
+
+private:
+
+    struct Node
+    {
+        int             name;           // index into m_names
+        int             parent;         // -1 for roots
+        std::vector<int> children;
+        bool            counter;
+        double          frameTotal = 0; // this frame so far
+        bool            touched = false;
+        Histogram       histogram;
+    };
+
+    struct Event
+    {
+        int         node;
+        int         frame;
+        int64_t     start;              // microseconds since the profiler started
+        int32_t     duration;           // microseconds, -1 for counters
+        double      value;              // counter value
+    };
+
+    static Profiler* instance;
+
+    std::vector<std::string>    m_names;
+    std::vector<Node>           m_nodes;
+    std::vector<int>            m_touched;      // nodes with something recorded this frame
+    std::vector<Event>          m_ring;
+    size_t                      m_ringNext = 0;
+    size_t                      m_ringSize = 0;
+    std::array<int, MaxDepth>   m_stack{};
+    int                         m_depth = 0;
+    int                         m_frame = -1;
+    Clock::time_point           m_epoch;
+
+    Profiler();
+
+    int     child(int parent, int name, bool counter);
+    void    record(const Event & event);
+    void    endFrame();
+    void    writeNode(std::ostream & out, int node, int indent) const;
+
+public:
+
+    Profiler(Profiler& other) = delete;
+    void operator=(const Profiler&) = delete;
+
+    static Profiler* getInstance();
+
+    // a name gets an id the first time its call site runs
+    int     nameId(const char * name);
+
+    void    beginFrame(int frame);
+    void    enter(int name);
+    void    leave(Clock::time_point start);
+    void    count(int name, double value);
+
+    // writes <path>.txt with the summary and <path>.json with the trace
+    void    writeReport(const std::string & path);
+
+    // opens a scope for as long as it lives
+    class Scope
+    {
+        Clock::time_point m_start;
+    public:
+        explicit Scope(int name) { Profiler::getInstance()->enter(name); m_start = Clock::now(); }
+        ~Scope() { Profiler::getInstance()->leave(m_start); }
+        Scope(const Scope &) = delete;
+        void operator=(const Scope &) = delete;
+    };
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_FRAME(frame) Profiler::getInstance()->beginFrame(frame)
+
+#define PROFILE_SCOPE(name) \
+    static const int PROFILE_CONCAT(profileName_, __LINE__) = Profiler::getInstance()->nameId(name); \
+    Profiler::Scope PROFILE_CONCAT(profileScope_, __LINE__)(PROFILE_CONCAT(profileName_, __LINE__))
+
+#define PROFILE_COUNT(name, value) do { \
+        static const int profileCounterName = Profiler::getInstance()->nameId(name); \
+        Profiler::getInstance()->count(profileCounterName, (double)(value)); \
+    } while (false)
+
+#define PROFILE_REPORT(path) Profiler::getInstance()->writeReport(path)
+
+#else
+
+#define PROFILE_FRAME(frame)        ((void)0)
+#define PROFILE_SCOPE(name)         ((void)0)
+#define PROFILE_COUNT(name, value)  ((void)0)
+#define PROFILE_REPORT(path)        ((void)0)
+
+#endif
@@ -1,6 +1,15 @@
 #include "StarterBot.h"
 #include "Tools.h"
 #include "MapTools.h"
+#include "UnitIndex.h"
+#include "UnitCensus.h"
+#include "SupplyLedger.h"
+#include "MineralIndex.h"
+#include "Profiler.h"
+#include "DebugOverlay.h"
+
+#include <algorithm>
+#include <cmath>
 
 StarterBot::StarterBot(){}
 
@@ -8,6 +17,8 @@ StarterBot::StarterBot(){}
 // Called when the bot starts!
 void StarterBot::onStart()
 {
+    PROFILE_SCOPE("StarterBot::onStart");
+
     gameJustStarted = true;
 
     // Set our BWAPI options here    
@@ -19,37 +30,111 @@ void StarterBot::onStart()
 
     // Call MapTools OnStart
     m_mapTools.onStart();
+
+    // Indice espacial de unidades, lo usan las busquedas de Tools desde el primer onStart
+    UnitIndex::getInstance()->onStart();
+
+    // Censo de nuestras unidades por tipo, lo usa BuildOrder y las funciones de Tools
+    UnitCensus::getInstance()->update();
+
+    // Suministro en construccion y ordenado, se actualiza con los eventos de unidades
+    SupplyLedger::getInstance()->onStart();
+
+    // Analizar bases y chokepoints repartiendo el trabajo en el pool de hilos
+    m_terrain.analyze(m_mapTools, m_threadPool);
+
+    // Parches de mineral de cada base con cuantos trabajadores tiene cada uno
+    MineralIndex::getInstance()->onStart(m_terrain);
+
+    // Mapas de amenaza terrestre y aerea de las unidades enemigas
+    m_threatMap.onStart();
  
     // Obtn la instancia de WorkerManager y llama a onStart
     WorkerManager* workerManager = WorkerManager::getInstance();
     workerManager->onStart();
 
     // Llama onStart de BuildOrder
-    buildOrder.onStart();
+    buildOrder.onStart(m_mapTools, m_terrain);
 
-    
+    // Registrar el trabajo de cada frame en el planificador
+    registerFrameTasks();
 }
 
 
-// Called on each frame of the game
-void StarterBot::onFrame()
+// Registra lo que se hace en cada frame con su prioridad y cada cuantos frames se quiere correr.
+// Las tareas Critical corren siempre y en este orden, las demas esperan al siguiente frame si no
+// alcanza el tiempo. El dibujo es lo primero que se deja de hacer.
+void StarterBot::registerFrameTasks()
 {
-    // Update our MapTools information
-    m_mapTools.onFrame();    
+    using Priority = FrameScheduler::Priority;
+    m_scheduler.clear();
 
-    // Draw unit health bars, which brood war unfortunately does not do
-    Tools::DrawUnitHealthBars();
+    // Reiniciar el presupuesto de figuras de depuracion de este frame
+    m_scheduler.add("overlay", Priority::Critical, 1, [] { DebugOverlay::getInstance()->beginFrame(); });
+
+    // Reconstruir el indice espacial de unidades una vez por frame
+    m_scheduler.add("unit index", Priority::Critical, 1, [] { UnitIndex::getInstance()->rebuild(); });
+
+    // Contar nuestras unidades por tipo en una sola pasada
+    m_scheduler.add("census", Priority::Critical, 1, [] { UnitCensus::getInstance()->update(); });
+
+    // Olvidar las ordenes de construccion de suministro que ya no siguen en pie
+    m_scheduler.add("supply", Priority::Critical, 1, [] { SupplyLedger::getInstance()->onFrame(); });
+
+    // Muestrear lo recolectado para estimar el ingreso por frame
+    m_scheduler.add("income", Priority::Critical, 1, [] { ResourceManager::getInstance()->onFrame(); });
+
+    // Cambios de visibilidad del frame; no puede saltarse frames o lastSeen y los cambios se atrasan
+    m_scheduler.add("map", Priority::Critical, 1, [this] { m_mapTools.onFrame(); });
+
+    // Actualizar la amenaza solo alrededor de los enemigos que se movieron
+    m_scheduler.add("threat", Priority::High, 1, [this] { m_threatMap.onFrame(); });
 
-    // Draw some relevent information to the screen to help us debug the bot
-    drawDebugInformation();
-    
-    
     // Llama al onFrame del WorkerManager
-    WorkerManager* workerManager = WorkerManager::getInstance();
-    workerManager->onFrame();
-    
+    m_scheduler.add("workers", Priority::High, 1, [] { WorkerManager::getInstance()->onFrame(); });
+
+    // Revisar a los trabajadores por partes, buscando ociosos de los que no avis ningn evento
+    m_scheduler.addSliced("worker sweep", Priority::Normal, 24, [](FrameScheduler::Clock::time_point deadline)
+    {
+        return WorkerManager::getInstance()->reconcileWorkers(deadline);
+    });
+
     // Llama a onFrame de BuildOrder
-    buildOrder.onFrame();
+    m_scheduler.add("build order", Priority::High, 1, [this] { buildOrder.onFrame(); });
+
+    // Cuando se acaban los pasos del script, la busqueda planea en los hilos del pool como llegar al
+    // objetivo; aca solo se lanza y se recoge el plan
+    m_scheduler.add("build search", Priority::Normal, 24, [this] {
+        if (m_buildSearch.finished()) {
+            buildOrder.setPlan(m_buildSearch.takePlan());
+        }
+        else if (!m_buildSearch.running() && buildOrder.needsPlan()) {
+            ResourceManager* resourceManager = ResourceManager::getInstance();
+            if (!m_buildSearch.start(m_threadPool, buildOrder.getGoal(), resourceManager->getAvailableMinerals(), resourceManager->getAvailableGas())) {
+                buildOrder.setPlan({});
+            }
+        }
+    });
+
+    // Dibujo del mapa, solo si se activo
+    m_scheduler.add("map draw", Priority::Low, 1, [this] { m_mapTools.onDraw(); });
+
+    // Draw unit health bars, which brood war unfortunately does not do
+    m_scheduler.add("health bars", Priority::Low, 1, [] { Tools::DrawUnitHealthBars(); });
+
+    // Draw some relevent information to the screen to help us debug the bot
+    m_scheduler.add("debug", Priority::Low, 1, [this] { drawDebugInformation(); });
+}
+
+
+// Called on each frame of the game
+void StarterBot::onFrame()
+{
+    PROFILE_FRAME(BWAPI::Broodwar->getFrameCount());
+    PROFILE_SCOPE("StarterBot::onFrame");
+
+    // Correr las tareas del frame sin pasarse del limite de tiempo
+    m_scheduler.onFrame();
 
     gameJustStarted = false;
 }
@@ -67,7 +152,7 @@ void StarterBot::sendIdleWorkersToMinerals()
         if (unit->getType().isWorker() && unit->isIdle())
         {
             // Get the closest mineral to this worker unit
-            BWAPI::Unit closestMineral = Tools::GetClosestUnitTo(unit, BWAPI::Broodwar->getMinerals());
+            BWAPI::Unit closestMineral = Tools::getClosestMineralField(unit->getPosition());
 
             // If a valid mineral was found, right click it with the unit in order to start harvesting
             if (closestMineral) { unit->rightClick(closestMineral); }
@@ -81,7 +166,7 @@ void StarterBot::trainAdditionalWorkers()
 {
     const BWAPI::UnitType workerType = BWAPI::Broodwar->self()->getRace().getWorker();
     const int workersWanted = 20;
-    const int workersOwned = Tools::CountCompletedUnitsOfType(workerType, BWAPI::Broodwar->self()->getUnits());
+    const int workersOwned = Tools::CountCompletedUnitsOfType(workerType);
     if (workersOwned < workersWanted)
     {
         // get the unit pointer to my depot
@@ -97,16 +182,20 @@ void StarterBot::trainAdditionalWorkers()
 // Build more supply if we are going to run out soon
 void StarterBot::buildAdditionalSupply()
 {
-    // Get the amount of supply supply we currently have unused
-    const int unusedSupply = Tools::GetTotalSupply(true) - BWAPI::Broodwar->self()->supplyUsed();
+    const BWAPI::UnitType supplyProviderType = BWAPI::Broodwar->self()->getRace().getSupplyProvider();
+    SupplyLedger* supplyLedger = SupplyLedger::getInstance();
+
+    // Nothing to do once we can't get more supply
+    if (supplyLedger->total(true) >= SupplyLedger::MaxSupply) { return; }
 
-    // If we have a sufficient amount of supply, we don't need to do anything
-    if (unusedSupply >= 2) { return; }
+    // Look ahead as long as a new supply provider takes to get there and finish: if production
+    // will still have supply left by then, we don't need to do anything yet
+    const int lookahead = SupplyLedger::OrderTravelFrames + supplyProviderType.buildTime();
+    if (supplyLedger->projectedFree(lookahead) >= 2) { return; }
 
     // Otherwise, we are going to build a supply provider
-    const BWAPI::UnitType supplyProviderType = BWAPI::Broodwar->self()->getRace().getSupplyProvider();
 
-    const bool startedBuilding = Tools::BuildBuilding(supplyProviderType);
+    const bool startedBuilding = Tools::BuildBuilding(m_mapTools, supplyProviderType);
     if (startedBuilding)
     {
         BWAPI::Broodwar->printf("Started Building %s", supplyProviderType.getName().c_str());
@@ -119,44 +208,61 @@ void StarterBot::drawDebugInformation()
 {
     drawPositionsOfAllUnits();
     drawResourceManagerInfo();
+    drawBuildOrderInfo();
     Tools::DrawUnitCommands();
     Tools::DrawUnitBoundingBoxes();
+
+    if (m_drawTerrain)
+    {
+        m_terrain.draw();
+    }
 }
 
 // Dibuja la informacion del ResourceManager
 void StarterBot::drawResourceManagerInfo()
 {
-    BWAPI::Position pos = BWAPI::Position(2, 2);
-    // Parse
+    DebugOverlay* overlay = DebugOverlay::getInstance();
+    if (!overlay->enabled(DebugOverlay::Channel::Resources)) { return; }
+
     ResourceManager* resourceManager = ResourceManager::getInstance();
-    std::string info = "mineral: " + std::to_string(resourceManager->getAvailableMinerals()) + "\n"
-        "gas: " + std::to_string(resourceManager->getAvailableGas());
+    overlay->textScreen(2, 2, "mineral: %d (%.0f/min)\ngas: %d (%.0f/min)\nreservas: %d",
+        resourceManager->getAvailableMinerals(), resourceManager->getMineralRate() * 24 * 60,
+        resourceManager->getAvailableGas(), resourceManager->getGasRate() * 24 * 60,
+        resourceManager->getReservationCount());
+}
 
-    // Draw
+// Dibuja el avance del build order y los datos de la ultima busqueda
+void StarterBot::drawBuildOrderInfo()
+{
+    DebugOverlay* overlay = DebugOverlay::getInstance();
+    if (!overlay->enabled(DebugOverlay::Channel::BuildOrder)) { return; }
 
-    BWAPI::Broodwar->drawTextScreen(pos, info.c_str());
+    overlay->textScreen(2, 40, "build order '%s': paso %d de %d\nbusqueda: %s, listo en el frame %d (%lld nodos, %.0f ms)",
+        buildOrder.getStrategy().c_str(), (int)buildOrder.getCursor(), (int)buildOrder.size(),
+        m_buildSearch.running() ? "corriendo" : "quieta", m_buildSearch.planFrame(),
+        (long long)m_buildSearch.nodes(), m_buildSearch.elapsedMs());
 }
 
 
 // Dibuja las Position y Tile Position de todas las unidades
 void StarterBot::drawPositionsOfAllUnits()
 {
-    BWAPI::Unitset units = BWAPI::Broodwar->getAllUnits();
+    DebugOverlay* overlay = DebugOverlay::getInstance();
+    if (!overlay->enabled(DebugOverlay::Channel::Positions)) { return; }
+
+    // Solo las unidades en pantalla, el texto se formatea en la arena del frame
+    const BWAPI::Position screen = overlay->screen();
+    std::vector<BWAPI::Unit> units;
+    UnitIndex::getInstance()->getInRectangle(screen.x, screen.y, screen.x + Tools::SCREEN_WIDTH, screen.y + Tools::SCREEN_HEIGHT, UnitFilter(), units);
+
     for (auto unit : units)
     {
         // Obtener todas las posiciones
-        BWAPI::Position position = unit->getPosition();
-        BWAPI::TilePosition tilePosition = unit->getTilePosition();
-        
-        // Parse
-        std::string info = "(" + std::to_string(position.x) + "," + std::to_string(position.y) + ") " +
-            "Tile: (" + std::to_string(tilePosition.x) + "," + std::to_string(tilePosition.y) + ")";
+        const BWAPI::Position position = unit->getPosition();
+        const BWAPI::TilePosition tilePosition = unit->getTilePosition();
 
-        // Draw
-        BWAPI::Broodwar->drawTextMap(position, info.c_str());
-                
+        overlay->text(position.x, position.y, "(%d,%d) Tile: (%d,%d)", position.x, position.y, tilePosition.x, tilePosition.y);
     }
-
 }
 
 
@@ -164,13 +270,23 @@ void StarterBot::drawPositionsOfAllUnits()
 void StarterBot::onEnd(bool isWinner)
 {
     std::cout << "We " << (isWinner ? "won!" : "lost!") << "\n";
+
+    // Que las tareas de la busqueda no sigan hasta su limite de tiempo
+    m_buildSearch.cancel();
+
+    // Resumen de tiempos por frame y traza para chrome://tracing
+    PROFILE_REPORT("bwapi-data/write/profile");
 }
 
 
 // Called whenever a unit is destroyed, with a pointer to the unit
 void StarterBot::onUnitDestroy(BWAPI::Unit unit)
 {
-	
+    MineralIndex::getInstance()->onUnitDestroy(unit);
+    WorkerManager::getInstance()->onUnitDestroy(unit);
+    SupplyLedger::getInstance()->onUnitDestroy(unit);
+    m_threatMap.onUnitDestroy(unit);
+    m_mapTools.removeBuilding(unit);
 }
 
 
@@ -178,7 +294,9 @@ void StarterBot::onUnitDestroy(BWAPI::Unit unit)
 // Zerg units morph when they turn into other units
 void StarterBot::onUnitMorph(BWAPI::Unit unit)
 {
-	
+    WorkerManager::getInstance()->onUnitMorph(unit);
+    SupplyLedger::getInstance()->onUnitMorph(unit);
+    m_mapTools.addBuilding(unit);
 }
 
 
@@ -190,6 +308,23 @@ void StarterBot::onSendText(std::string text)
     {
         m_mapTools.toggleDraw();
     }
+    else if (text == "/terrain")
+    {
+        m_drawTerrain = !m_drawTerrain;
+    }
+    else if (text == "/threat")
+    {
+        m_threatMap.toggleDraw();
+    }
+    else if (text == "/scheduler")
+    {
+        m_scheduler.toggleDraw();
+    }
+    else if (text.size() > 1 && text[0] == '/')
+    {
+        // Canales de depuracion: /positions, /resources, /commands, /boxes, /health, /build y /debug para todos
+        DebugOverlay::getInstance()->toggleChannel(text.substr(1));
+    }
     else if (text == "hola")
     {
         BWAPI::Broodwar->sendText("mundo:)");
@@ -202,6 +337,11 @@ void StarterBot::onSendText(std::string text)
 // so this will trigger when you issue the build command for most units
 void StarterBot::onUnitCreate(BWAPI::Unit unit)
 { 
+    // Marcar el terreno que ocupa el edificio en el indice de construccion
+    m_mapTools.addBuilding(unit);
+
+    // Un proveedor de suministro empezo a construirse
+    SupplyLedger::getInstance()->onUnitCreate(unit);
     
 	// Llama al metodo onUnitCreate del WorkerManager
     WorkerManager* workerManager = WorkerManager::getInstance();
@@ -219,7 +359,9 @@ void StarterBot::onUnitCreate(BWAPI::Unit unit)
 // Called whenever a unit finished construction, with a pointer to the unit
 void StarterBot::onUnitComplete(BWAPI::Unit unit)
 {
-	
+    SupplyLedger::getInstance()->onUnitComplete(unit);
+    MineralIndex::getInstance()->onUnitComplete(unit);
+    WorkerManager::getInstance()->onUnitComplete(unit);
 }
 
 
@@ -227,7 +369,7 @@ void StarterBot::onUnitComplete(BWAPI::Unit unit)
 // This is usually triggered when units appear from fog of war and become visible
 void StarterBot::onUnitShow(BWAPI::Unit unit)
 { 
-	
+    m_mapTools.addBuilding(unit);
 }
 
 
@@ -248,6 +390,117 @@ void StarterBot::onUnitRenegade(BWAPI::Unit unit)
 // ************************ResourceManager**********************************
 ResourceManager* ResourceManager::instance = nullptr;
 
+void ResourceManager::onFrame()
+{
+    const BWAPI::Player self = BWAPI::Broodwar->self();
+
+    incomeSamples[incomeNext] = { BWAPI::Broodwar->getFrameCount(), self->gatheredMinerals(), self->gatheredGas() };
+    incomeNext = (incomeNext + 1) % IncomeSamples;
+    incomeCount = std::min(incomeCount + 1, IncomeSamples);
+
+    const IncomeSample& newest = incomeSamples[(incomeNext + IncomeSamples - 1) % IncomeSamples];
+    const IncomeSample& oldest = incomeSamples[(incomeNext + IncomeSamples - incomeCount) % IncomeSamples];
+    const int span = newest.frame - oldest.frame;
+
+    // Al empezar la partida todavia no hay muestras suficientes: estimar con los trabajadores
+    if (span < MinIncomeSpan) {
+        mineralRate = UnitCensus::getInstance()->workers().size() * MineralsPerWorkerFrame;
+        gasRate = 0;
+        return;
+    }
+
+    mineralRate = (newest.minerals - oldest.minerals) / (double)span;
+    gasRate = (newest.gas - oldest.gas) / (double)span;
+}
+
+int ResourceManager::reserve(int frame, int minerals, int gas)
+{
+    const Reservation reservation = { nextReservationId++, frame, minerals, gas };
+
+    // Insertar despues de las reservas del mismo frame para que queden en orden de llegada
+    auto it = std::upper_bound(reservations.begin(), reservations.end(), frame,
+        [](int f, const Reservation& r) { return f < r.frame; });
+    reservations.insert(it, reservation);
+
+    return reservation.id;
+}
+
+void ResourceManager::cancelReservation(int id)
+{
+    auto it = std::find_if(reservations.begin(), reservations.end(), [id](const Reservation& r) { return r.id == id; });
+    if (it != reservations.end()) {
+        reservations.erase(it);
+    }
+}
+
+namespace
+{
+    // Primer frame desde start en el que value(f) = value0 + rate * (f - now) llega a target
+    int FrameToReach(double value0, double rate, int target, int start, int now)
+    {
+        if (target <= 0 || value0 + rate * (start - now) >= target) { return start; }
+        if (rate <= 0) { return ResourceManager::NeverAffordable; }
+
+        const double frames = std::ceil((target - value0) / rate - 1e-9); // sin el margen, 60 / 0.3 redondea a 201
+        if (frames >= ResourceManager::NeverAffordable - now) { return ResourceManager::NeverAffordable; }
+
+        return std::max(start, now + (int)frames);
+    }
+}
+
+// Entre dos reservas lo disponible crece con el ingreso, y en cada reserva baja de golpe. Gastar en
+// el frame f es posible si en f alcanza y si despues de cada reserva posterior sigue alcanzando, asi
+// que se recorren los tramos entre reservas con el minimo de lo que sobra despues de cada una.
+int ResourceManager::earliestAffordableFrame(int minerals, int gas) const
+{
+    const int now = BWAPI::Broodwar->getFrameCount();
+    const double minerals0 = getAvailableMinerals();
+    const double gas0 = getAvailableGas();
+    const size_t n = reservations.size();
+
+    // Lo minimo que sobra despues de la reserva i o de cualquier reserva posterior
+    std::vector<double> minMinerals(n + 1, std::numeric_limits<double>::max());
+    std::vector<double> minGas(n + 1, std::numeric_limits<double>::max());
+    double reservedMinerals = 0;
+    double reservedGas = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const int frames = std::max(0, reservations[i].frame - now);
+        reservedMinerals += reservations[i].minerals;
+        reservedGas += reservations[i].gas;
+        minMinerals[i] = minerals0 + mineralRate * frames - reservedMinerals;
+        minGas[i] = gas0 + gasRate * frames - reservedGas;
+    }
+    for (size_t i = n; i-- > 0;) {
+        minMinerals[i] = std::min(minMinerals[i], minMinerals[i + 1]);
+        minGas[i] = std::min(minGas[i], minGas[i + 1]);
+    }
+
+    // El tramo k va desde la reserva k-1 (o ahora) hasta la reserva k, sin incluirla
+    reservedMinerals = 0;
+    reservedGas = 0;
+    for (size_t k = 0; k <= n; ++k) {
+        if (k > 0) {
+            reservedMinerals += reservations[k - 1].minerals;
+            reservedGas += reservations[k - 1].gas;
+        }
+
+        if ((minerals > 0 && minMinerals[k] < minerals) || (gas > 0 && minGas[k] < gas)) {
+            continue;
+        }
+
+        const int start = k == 0 ? now : std::max(now, reservations[k - 1].frame);
+        const int end = k == n ? NeverAffordable : std::max(now, reservations[k].frame);
+
+        const int frame = std::max(FrameToReach(minerals0 - reservedMinerals, mineralRate, minerals, start, now),
+                                   FrameToReach(gas0 - reservedGas, gasRate, gas, start, now));
+        if (frame < end) {
+            return frame;
+        }
+    }
+
+    return NeverAffordable;
+}
+
 
 
 
@@ -268,15 +521,16 @@ WorkerManager* WorkerManager::getInstance()
 WorkerManager::WorkerManager() {}
 
 void WorkerManager::onStart() {
-    // Asegurarse de que las listas y mapas estn vacos.
+    // Asegurarse de que el registro y las colas estn vacos.
     workers.clear();
-    workerAssignments.clear();
-    workerBuildTargets.clear();
+    idleQueue.clear();
+    constructions.clear();
+    sweepCursor = 0;
 
     // Identificar y almacenar los trabajadores iniciales.
     for (auto& unit : BWAPI::Broodwar->self()->getUnits()) {
         if (unit->getType().isWorker()) {
-            workers.push_back(unit);
+            workers.add(unit);
             // Por defecto, asumiremos que todos los trabajadores deberan estar recolectando minerales.
             assignWorkerToMinerals(unit);
         }
@@ -291,48 +545,122 @@ void WorkerManager::assignWorkerToGas(BWAPI:: Unit worker)
 }
 
 void WorkerManager::assignWorkerToMinerals(BWAPI::Unit worker) {
-    // Encontrar el parche de mineral ms cercano
-    BWAPI::Unit mineralPatch = Tools::getClosestMineralField(worker->getPosition());
+    // Soltar el parche que tuviera antes para que no cuente dos veces
+    releaseMinerals(worker);
+
+    // El parche menos saturado de la base propia ms cercana; si no queda ninguno, el ms cercano del mapa
+    BWAPI::Unit mineralPatch = MineralIndex::getInstance()->assign(worker->getPosition());
+    if (!mineralPatch) {
+        mineralPatch = Tools::getClosestMineralField(worker->getPosition());
+    }
 
     if (mineralPatch) {
         // Asignar el trabajador al parche de mineral
-        workerAssignments[worker] = mineralPatch;
+        workers.setRole(worker, WorkerRole::Minerals);
+        workers.setResource(worker, mineralPatch);
 
         // Ordenar al trabajador que recolecte minerales
         worker->gather(mineralPatch);
     }
 }
 
+void WorkerManager::releaseMinerals(BWAPI::Unit worker)
+{
+    if (workers.getRole(worker) == WorkerRole::Minerals) {
+        MineralIndex::getInstance()->release(workers.getResource(worker));
+        workers.setResource(worker, nullptr);
+    }
+}
+
 void WorkerManager::balanceWorkerAllocation()
 {
 
 }
 
+// Estados de un trabajador (WorkerRole) y que los cambia:
+//   Idle     -> Minerals  sendIdleWorkersToWork, al sacarlo de la cola
+//   Minerals -> Build     assignWorkerToBuild
+//   Build    -> Idle      se coloca el edificio (protoss), se termina o se cancela (terran)
+//   *        -> Idle      el parche se agota, o el barrido lo encuentra ocioso
+// Solo los trabajadores que pasan a Idle se revisan en el frame, nunca la lista completa.
 void WorkerManager::sendIdleWorkersToWork()
 {
-    // Iterar sobre todos los trabajadores para asegurarse de que estn haciendo algo til.
-    for (auto& worker : workers) {
-        if (worker->isIdle()) {
-            // Si el trabajador est ocioso, asignarlo a recolectar minerales.
-            assignWorkerToMinerals(worker);
+    for (size_t i = 0; i < idleQueue.size(); ++i) {
+        BWAPI::Unit worker = idleQueue[i];
+
+        // Descartar los que murieron, ya se reasignaron o todavia no terminan de entrenarse
+        if (!workers.contains(worker) || workers.getRole(worker) != WorkerRole::Idle || !worker->isCompleted()) {
+            continue;
         }
-        else {
-            // Aqui podra agregar lgica adicional para manejar otros casos, como trabajadores que estn construyendo, recolectando gas, etc.
+
+        assignWorkerToMinerals(worker);
+    }
+    idleQueue.clear();
+}
+
+void WorkerManager::setIdle(BWAPI::Unit worker)
+{
+    if (!workers.contains(worker)) {
+        return;
+    }
+
+    releaseMinerals(worker);
+    workers.setRole(worker, WorkerRole::Idle);
+    idleQueue.push_back(worker);
+}
+
+// El trabajador con la orden de construir este edificio. Los probes no quedan ligados a lo que
+// invocan, asi que si no hay getBuildUnit se busca por tipo y casilla entre los constructores.
+BWAPI::Unit WorkerManager::findBuilderOf(BWAPI::Unit building)
+{
+    BWAPI::Unit builder = building->getBuildUnit();
+    if (builder && workers.getRole(builder) == WorkerRole::Build) {
+        return builder;
+    }
+
+    for (auto& worker : workers.getWorkers(WorkerRole::Build)) {
+        if (workers.getBuildType(worker) == building->getType() && workers.getBuildTarget(worker) == building->getTilePosition()) {
+            return worker;
         }
     }
+
+    return nullptr;
 }
 
-void WorkerManager::manageConstructionWorkers() {
-    for (auto& [worker, buildTarget] : workerBuildTargets) {
-        if (worker->isConstructing()) {
-            // Si el trabajador est construyendo, asegurarte de que contine construyendo.
-            // Aqui podria agregar lgica para manejar casos en los que la construccin se interrumpa, etc.
+bool WorkerManager::reconcileWorkers(FrameScheduler::Clock::time_point deadline)
+{
+    const std::vector<BWAPI::Unit>& all = workers.getWorkers();
+    const int frame = BWAPI::Broodwar->getFrameCount();
+    int checked = 0;
+
+    // Cambiar el rol no mueve a nadie en la lista completa, solo quitar trabajadores
+    while (sweepCursor < all.size()) {
+        if (checked == SweepBatch || FrameScheduler::Clock::now() >= deadline) {
+            return false;
         }
-        else {
-            // Si el trabajador no est construyendo, enviarlo al lugar de construccin.
-            //worker->move(BWAPI::Position(buildTarget));
+
+        BWAPI::Unit worker = all[sweepCursor++];
+        ++checked;
+
+        // Una orden recien dada todavia no se ve en isIdle, no confundirla con un trabajador ocioso
+        if (frame - worker->getLastCommandFrame() <= BWAPI::Broodwar->getLatencyFrames()) {
+            continue;
+        }
+
+        // Los constructores enviados por adelantado esperan en el sitio a que alcance el dinero, pero
+        // no para siempre: si el paso nunca se construye, el barrido los devuelve al trabajo
+        if (workers.getRole(worker) == WorkerRole::Build && worker->getLastCommand().getType() == BWAPI::UnitCommandTypes::Move
+            && frame - worker->getLastCommandFrame() <= BuilderWaitFrames) {
+            continue;
+        }
+
+        if (worker->isCompleted() && worker->isIdle()) {
+            setIdle(worker);
         }
     }
+
+    sweepCursor = 0;
+    return true;
 }
 
 BWAPI::Unit WorkerManager::getLeastBusyWorker()
@@ -347,16 +675,57 @@ void WorkerManager::assignWorkerToBuild(BWAPI::Unit worker, BWAPI::UnitType buil
     }
 
     // Asignar al trabajador la tarea de construccin
-    workerBuildTargets[worker] = buildPosition;
+    releaseMinerals(worker);
+    workers.setRole(worker, WorkerRole::Build);
+    workers.setBuildTarget(worker, buildingType, buildPosition);
 
     // Ordenar al trabajador que construya
     worker->build(buildingType, buildPosition);
 }
 
 
+void WorkerManager::sendBuilderAhead(BWAPI::Unit worker, BWAPI::UnitType buildingType, BWAPI::TilePosition buildPosition) {
+    if (!workers.contains(worker)) {
+        return;
+    }
+
+    releaseMinerals(worker);
+    workers.setRole(worker, WorkerRole::Build);
+    workers.setBuildTarget(worker, buildingType, buildPosition);
+
+    // Ir al centro del edificio; la orden de construir se da cuando alcance el dinero
+    worker->move(BWAPI::Position(buildPosition) + BWAPI::Position(buildingType.tileWidth() * 16, buildingType.tileHeight() * 16));
+}
+
+bool WorkerManager::isAssignedToBuild(BWAPI::Unit worker, BWAPI::UnitType buildingType) const {
+    return workers.contains(worker) && workers.getRole(worker) == WorkerRole::Build && workers.getBuildType(worker) == buildingType;
+}
+
+void WorkerManager::cancelBuilderAhead(BWAPI::Unit worker) {
+    // Los que ya tienen la orden de construir los libera su edificio al terminar
+    if (!workers.contains(worker) || workers.getRole(worker) != WorkerRole::Build
+        || worker->getLastCommand().getType() != BWAPI::UnitCommandTypes::Move) {
+        return;
+    }
+
+    setIdle(worker);
+}
+
+
 void WorkerManager::onBuildingCompletion(BWAPI::Unit building)
 {
+    // El SCV que lo construia queda libre
+    for (size_t i = 0; i < constructions.size(); ++i) {
+        if (constructions[i].first != building) {
+            continue;
+        }
 
+        BWAPI::Unit worker = constructions[i].second;
+        constructions[i] = constructions.back();
+        constructions.pop_back();
+        setIdle(worker);
+        return;
+    }
 }
 
 void WorkerManager::protectWorkers()
@@ -396,14 +765,14 @@ void WorkerManager::generateWorkerReport()
 }
 
 void WorkerManager::onFrame() {
+    PROFILE_SCOPE("WorkerManager::onFrame");
+
     // Mandar a los trabajadores que no hacen nada a los minerales
     sendIdleWorkersToWork();
 
     // Verificar si necesitas equilibrar la asignacin de trabajadores entre minerales y gas.
     balanceWorkerAllocation();
 
-    // Gestionar trabajadores en construccin.
-    manageConstructionWorkers();
 
     // Otras tareas especficas en cada frame
     protectWorkers();
@@ -414,13 +783,11 @@ void WorkerManager::onFrame() {
 }
 
 BWAPI::Unit WorkerManager::findBuilder() {
-    // Obtener todos los trabajadores
-    BWAPI::Unitset workers = BWAPI::Broodwar->self()->getUnits();
     BWAPI::Unit builder = nullptr;
 
-    // Buscar un trabajador que est minando minerales
-    for (auto& worker : workers) {
-        if (worker->getType().isWorker() && worker->isGatheringMinerals()) {
+    // Buscar un trabajador que est minando minerales, solo entre los que tienen ese rol
+    for (auto& worker : workers.getWorkers(WorkerRole::Minerals)) {
+        if (worker->isGatheringMinerals()) {
             builder = worker;
             break;
         }
@@ -430,268 +797,429 @@ BWAPI::Unit WorkerManager::findBuilder() {
 }
 
 void WorkerManager::onUnitCreate(BWAPI::Unit unit) {
-    // Verificar si la unidad es un trabajador y pertenece al jugador actual
-    if (unit->getType().isWorker() && unit->getPlayer() == BWAPI::Broodwar->self()) {
-        workers.push_back(unit);
+    if (unit->getPlayer() != BWAPI::Broodwar->self()) {
+        return;
     }
-}
 
+    // Los trabajadores nuevos entran en Idle y se encolan cuando terminan de entrenarse
+    if (unit->getType().isWorker()) {
+        workers.add(unit);
+        return;
+    }
 
-// ************************Action**********************************
+    // Se coloc un edificio: el SCV sigue ocupado hasta terminarlo, el probe queda libre enseguida
+    if (unit->getType().isBuilding()) {
+        BWAPI::Unit builder = findBuilderOf(unit);
+        if (!builder) {
+            return;
+        }
 
+        if (unit->getType().getRace() == BWAPI::Races::Terran) {
+            constructions.push_back({ unit, builder });
+        }
+        else {
+            setIdle(builder);
+        }
+    }
+}
 
+void WorkerManager::onUnitComplete(BWAPI::Unit unit) {
+    if (unit->getPlayer() != BWAPI::Broodwar->self()) {
+        return;
+    }
 
-Action::Action(BWAPI::UnitType type, int supplyTrigger)
-    : type(type), supplyTrigger(supplyTrigger),
-    mineralCost(type.mineralPrice()), 
-    gasCost(type.gasPrice()) { }
+    if (unit->getType().isWorker()) {
+        // Incluye los Drones, que salen de un huevo sin pasar por onUnitCreate como trabajadores
+        workers.add(unit);
+        if (workers.getRole(unit) == WorkerRole::Idle) {
+            idleQueue.push_back(unit);
+        }
+    }
+    else if (unit->getType().isBuilding()) {
+        onBuildingCompletion(unit);
+    }
+}
 
+void WorkerManager::onUnitDestroy(BWAPI::Unit unit) {
+    // Un parche de mineral se agot: mandar a sus trabajadores a otro
+    if (unit->getType().isMineralField()) {
+        std::vector<BWAPI::Unit> miners;
+        for (auto& worker : workers.getWorkers(WorkerRole::Minerals)) {
+            if (workers.getResource(worker) == unit) {
+                miners.push_back(worker);
+            }
+        }
+        for (auto& worker : miners) {
+            assignWorkerToMinerals(worker);
+        }
+        return;
+    }
 
-int Action::getSupplyTrigger() { return supplyTrigger; }
+    // Un edificio terran destruido o cancelado a medio construir libera a su SCV
+    if (unit->getType().isBuilding()) {
+        onBuildingCompletion(unit);
+        return;
+    }
 
-int Action::getMineralCost() { return mineralCost; }
+    // Sacar del registro a los trabajadores muertos, junto con su rol y sus asignaciones
+    releaseMinerals(unit);
+    workers.remove(unit);
+}
 
-int Action::getGasCost() { return gasCost; }
+void WorkerManager::onUnitMorph(BWAPI::Unit unit) {
+    // Un Drone que se convierte en edificio deja de ser trabajador
+    if (!unit->getType().isWorker()) {
+        releaseMinerals(unit);
+        workers.remove(unit);
+    }
+}
 
 
-// **************************BuildAction******************************
+// ****************************BuildOrder**************************
 
-BuildAction::BuildAction::BuildAction(BWAPI::UnitType type, int supplyTrigger, BWAPI::TilePosition buildPosition)
-    : Action(type, supplyTrigger), buildPosition(buildPosition) {
-    
-    // Calcular el costo de minerales y gas a partir del tipo de unidad.
-    mineralCost = type.mineralPrice();
-    gasCost = type.gasPrice();
-}
 
-bool BuildAction::canExecute()
+bool BuildOrder::canExecute(const BuildStep& step) const
 {
-    // Instanciar el ResourceManager
-    ResourceManager* resourceManager = ResourceManager::getInstance();
+    // El dinero ya lo revisa onFrame con la linea de tiempo de reservas. canMake revisa los
+    // requisitos, asi una Academy no se intenta antes de tener Barracks.
+    const BWAPI::UnitType type = step.type();
+    if (!BWAPI::Broodwar->canMake(type) ||
+        SupplyLedger::getInstance()->free() < type.supplyRequired()) {
+        return false;
+    }
 
-    // Verificar recursos
-    if (resourceManager->getAvailableMinerals() < mineralCost ||
-        resourceManager->getAvailableGas() < gasCost ||
-        BWAPI::Broodwar->self()->supplyTotal() - BWAPI::Broodwar->self()->supplyUsed() < type.supplyRequired()) {
+    // Verificar si existe alguna estructura adecuada y disponible
+    if (step.kind == BuildStep::Train && !findTrainingStructure(type)) {
         return false;
     }
 
-    // Verificar disponibilidad de trabajador
-    //WorkerManager* workerManager = WorkerManager::getInstance();
-    //BWAPI::Unit builder = workerManager->findBuilder();
-    //if (!builder) {
-    //    return false;
-    //}
+    return true;
+}
 
-    // Verificar posicin de construccin (y cualquier otra condicin necesaria)
-    // ...
+BWAPI::Unit BuildOrder::findTrainingStructure(BWAPI::UnitType type) const
+{
+    // Solo se revisan los edificios ociosos del tipo que entrena esta unidad, segun el censo.
+    // Las unidades Zerg salen de las larvas, que se entrenan a traves de su Hatchery/Lair/Hive.
+    const BWAPI::UnitType builderType = type.whatBuilds().first;
+    if (builderType == BWAPI::UnitTypes::Zerg_Larva) {
+        for (auto& structureType : { BWAPI::UnitTypes::Zerg_Hatchery, BWAPI::UnitTypes::Zerg_Lair, BWAPI::UnitTypes::Zerg_Hive }) {
+            for (auto& unit : UnitCensus::getInstance()->idleUnits(structureType)) {
+                if (unit->canTrain(type)) {
+                    return unit;
+                }
+            }
+        }
+    }
 
-    return true;
+    if (!builderType.isBuilding()) {
+        return nullptr;
+    }
+
+    for (auto& unit : UnitCensus::getInstance()->idleUnits(builderType)) {
+        if (unit->canTrain(type)) {
+            return unit;
+        }
+    }
+    return nullptr;
 }
 
-void BuildAction::execute() 
+// Devuelve true si el paso termino: se dio la orden, o fallo y se descarta como antes para no
+// repetir el error cada frame. Sin trabajador o sin estructura libre el paso se reintenta.
+bool BuildOrder::execute(const BuildStep& step)
 {
+    return step.kind == BuildStep::Build ? executeBuild(step) : executeTrain(step);
+}
+
+bool BuildOrder::executeBuild(const BuildStep& step)
+{
+    const BWAPI::UnitType type = step.type();
 
     // Obtener un gestor de trabajadores
     WorkerManager* workerManager = WorkerManager::getInstance();
 
-    // Encontrar un trabajador para construir
-    BWAPI::Unit builder = workerManager->findBuilder();
-    if (!builder) {
-        BWAPI::Broodwar->printf("Error: No se encontr un trabajador para construir");
-        return;
+    // Usar el trabajador que se mand por adelantado para este paso, o encontrar uno para construir
+    const bool sentAhead = builder && &steps[builderStep] == &step && workerManager->isAssignedToBuild(builder, type);
+    BWAPI::Unit worker = sentAhead ? builder : workerManager->findBuilder();
+    if (!worker) {
+        return false;
     }
 
-    // Verificar si el lugar de construccin es vlido
-    BWAPI::TilePosition buildTile = buildPosition;
-    if (!BWAPI::Broodwar->canBuildHere(buildTile, type, builder)) {
+    // Verificar si el lugar de construccin es vlido. Se usa el que se resolvio al mandar al
+    // trabajador, salvo que otra cosa lo haya ocupado mientras llegaba; canBuildHere solo revisa
+    // ese lugar final.
+    BWAPI::TilePosition buildTile = sentAhead ? builderTile : findBuildTile(step);
+    if (sentAhead && (!buildTile.isValid() || !BWAPI::Broodwar->canBuildHere(buildTile, type, worker))) {
+        buildTile = findBuildTile(step);
+    }
+    if (!buildTile.isValid() || !BWAPI::Broodwar->canBuildHere(buildTile, type, worker)) {
         BWAPI::Broodwar->printf("Error: No se puede construir aqu");
-        return;
+        if (sentAhead) { releaseBuilder(); }
+        return true;
     }
 
     // Mover al trabajador a la posicin de construccin y comenzar a construir
-    bool constructionStarted = builder->build(type, buildTile);
+    bool constructionStarted = worker->build(type, buildTile);
     if (!constructionStarted) {
         BWAPI::Broodwar->printf("Error: La construccin no pudo comenzar");
-        return;
+        if (sentAhead) { releaseBuilder(); }
+        return true;
     }
 
+    // Si es un proveedor de suministro, su suministro cuenta desde que se da la orden
+    SupplyLedger::getInstance()->onBuildCommand(worker, type);
 
-    // Obtener el ResourceManager
+    // Descontar los recursos utilizados
     ResourceManager* resourceManager = ResourceManager::getInstance();
+    resourceManager->commitMinerals(step.minerals);
+    resourceManager->commitGas(step.gas);
 
-    // Descontar los recursos utilizados
-    resourceManager->commitMinerals(this->getMineralCost());
-    resourceManager->commitGas(this->getGasCost());
+    // Reservar el lugar para que otra construccion no lo use mientras el trabajador llega
+    map->reserveBuildLocation(type, buildTile);
 
     // Asignar el trabajador a la tarea de construccin
-    workerManager->assignWorkerToBuild(builder, type, buildTile);
+    workerManager->assignWorkerToBuild(worker, type, buildTile);
 
-}
-
-// ***************************TrainAction***************************
-
-
-TrainAction::TrainAction(BWAPI::UnitType type, int supplyTrigger)
-    : Action(type, supplyTrigger) { }
-
-
-BWAPI::Unit TrainAction::findTrainingStructure() {
-    for (auto& unit : BWAPI::Broodwar->self()->getUnits()) {
-        if (unit->getType().isBuilding() && unit->isIdle() && unit->canTrain(type)) {
-            return unit;
-        }
+    // El constructor por adelantado de otro paso sigue esperando el suyo
+    if (sentAhead) {
+        builder = nullptr;
+        builderTile = BWAPI::TilePositions::None;
     }
-    return nullptr;
+
+    return true;
 }
 
-bool TrainAction::canExecute() // los can execute y execute funcionan porque se ejecutan juntos, pero si es ejecutaran en distintos frames fallarian
+bool BuildOrder::executeTrain(const BuildStep& step)
 {
-    // Verificar recursos
-    if (BWAPI::Broodwar->self()->minerals() < mineralCost ||
-        BWAPI::Broodwar->self()->gas() < gasCost ||
-        BWAPI::Broodwar->self()->supplyTotal() - BWAPI::Broodwar->self()->supplyUsed() < type.supplyRequired()) {
-        return false;
-    }
+    const BWAPI::UnitType type = step.type();
 
-    // Verificar si existe alguna estructura adecuada y disponible
-    BWAPI::Unit structure = findTrainingStructure();
+    // Encontrar una estructura de entrenamiento adecuada
+    BWAPI::Unit structure = findTrainingStructure(type);
     if (!structure) {
         return false;
     }
 
-    // Cualquier otra condicin necesaria
-    // ...
-
+    // Iniciar la produccin de la unidad
+    if (structure->train(type)) {
+        BWAPI::Broodwar->printf("Entrenando una unidad de tipo: %s", type.c_str());
+    }
+    else {
+        BWAPI::Broodwar->printf("Error al intentar entrenar una unidad de tipo: %s", type.c_str());
+    }
     return true;
 }
 
-void TrainAction::execute()
+// Mandar al constructor cuando el viaje tarde lo que falta para tener el dinero, asi la orden de
+// construir sale apenas alcanza en vez de esperar a que el trabajador cruce la base
+void BuildOrder::prepare(const BuildStep& step, int affordableFrame)
 {
-    if (!canExecute()) { return; }
+    if (step.kind != BuildStep::Build) {
+        return;
+    }
 
-    // Encontrar una estructura de entrenamiento adecuada
-    BWAPI::Unit structure = findTrainingStructure();
-    if (!structure) {
-        return; // Si no encontramos una estructura, simplemente retornamos
+    const BWAPI::UnitType type = step.type();
+    WorkerManager* workerManager = WorkerManager::getInstance();
+    if (builder && builderStep == cursor && workerManager->isAssignedToBuild(builder, type)) {
+        return;
     }
 
-    // Iniciar la produccin de la unidad
-    bool startedTraining = structure->train(type);
+    releaseBuilder();
 
-    if (startedTraining) {
-        BWAPI::Broodwar->printf("Entrenando una unidad de tipo: %s", type.c_str());
+    // Sin los edificios que pide terminados, el trabajador solo esperaria parado en el lugar
+    UnitCensus* census = UnitCensus::getInstance();
+    for (auto& [requiredType, count] : type.requiredUnits()) {
+        if (census->completed(requiredType) < count) {
+            return;
+        }
     }
-    else {
-        BWAPI::Broodwar->printf("Error al intentar entrenar una unidad de tipo: %s", type.c_str());
+
+    BWAPI::Unit candidate = workerManager->findBuilder();
+    if (!candidate) {
+        return;
     }
-}
 
+    // El viaje se mide hasta donde de verdad se va a construir, no hasta la semilla
+    const BWAPI::TilePosition tile = findBuildTile(step);
+    if (!tile.isValid()) {
+        return;
+    }
 
-// ****************************BuildOrder**************************
+    const BWAPI::Position target = BWAPI::Position(tile) + BWAPI::Position(type.tileWidth() * 16, type.tileHeight() * 16);
+    const double speed = candidate->getType().topSpeed();
+    const int travelFrames = speed > 0 ? (int)(candidate->getDistance(target) / speed) : 0;
+    if (affordableFrame - BWAPI::Broodwar->getFrameCount() > travelFrames) {
+        return;
+    }
 
+    builder = candidate;
+    builderStep = cursor;
+    builderTile = tile;
+    workerManager->sendBuilderAhead(builder, type, tile);
+}
 
-void BuildOrder::addBuildAction(BWAPI::UnitType unitType, BWAPI::TilePosition buildPosition, int supplyTrigger )
+// Devuelve al trabajo al constructor enviado por adelantado, si el paso ya no lo necesita
+void BuildOrder::releaseBuilder()
 {
-    // si no le pasas un SupplyTrigger, se pondra por defecto la cantidad de Supplies que se necesitan para
-    // ese tipo de unidad.
-    if (supplyTrigger == -1) {
-        supplyTrigger = BWAPI::Broodwar->self()->supplyUsed() / 2;
+    if (builder) {
+        WorkerManager::getInstance()->cancelBuilderAhead(builder);
     }
-    
-    actions.push(std::make_unique<BuildAction>(unitType, supplyTrigger, buildPosition));
+    builder = nullptr;
+    builderTile = BWAPI::TilePositions::None;
 }
 
-void BuildOrder::addTrainAction(BWAPI::UnitType unitType, int supplyTrigger)
+// La posicion del paso es una semilla: el indice de MapTools da el lugar libre mas cercano. Las
+// refinerias van sobre el geiser, que el indice no considera construible.
+BWAPI::TilePosition BuildOrder::findBuildTile(const BuildStep& step) const
 {
-    // Si no le pasas un SupplyTrigger, se pondra por defecto la cantidad de Supplies en ese momento
-    if (supplyTrigger == -1) {
-        supplyTrigger = BWAPI::Broodwar->self()->supplyUsed() / 2;
+    if (step.type().isRefinery()) {
+        return step.tile();
     }
- 
-    actions.push(std::make_unique<TrainAction>(unitType, supplyTrigger));
+    return map->getBuildLocation(step.type(), step.tile());
 }
 
 
 void BuildOrder::onFrame()
 {
-    // Controlar que la cola no este vacia, para evitar comportamientos indefinidos
-    if (actions.empty()) { return; }
-    
-    auto& nextAction = actions.front();
+    PROFILE_SCOPE("BuildOrder::onFrame");
+
+    // Saltar los pasos que ya se hicieron adelantados
+    while (cursor < steps.size() && steps[cursor].done) {
+        ++cursor;
+    }
+
+    // El constructor mandado para un paso que ya no es el del cursor no tiene que seguir esperando
+    if (builder && builderStep != cursor) {
+        releaseBuilder();
+    }
+    if (cursor == steps.size()) { return; }
+
+    // Rehacer la reserva del paso del cursor con el ingreso actual
+    ResourceManager* resourceManager = ResourceManager::getInstance();
+    resourceManager->cancelReservation(reservation);
+    reservation = -1;
+
+    const int frame = BWAPI::Broodwar->getFrameCount();
     int currentSupply = BWAPI::Broodwar->self()->supplyUsed() / 2;  // Dividido por 2 porque BWAPI devuelve el doble del valor real
-    // Verificar recursos y ejecutar accin. 
-    if (nextAction->canExecute()) {
-        nextAction->execute();
-        actions.pop();
+
+    // Lo que se entrena en este frame todavia no se descuenta de los minerales del jugador
+    int spentMinerals = 0;
+    int spentGas = 0;
+
+    // El paso del cursor va primero y reserva su dinero para el frame en que le alcance; los que
+    // siguen solo se pagan ahora si con esa reserva todavia alcanza
+    int looked = 0;
+    for (size_t i = cursor; i < steps.size() && looked <= Lookahead; ++i) {
+        BuildStep& step = steps[i];
+        if (step.done) { continue; }
+        ++looked;
+
+        if (currentSupply < step.supplyTrigger) { continue; }
+
+        const int affordableFrame = resourceManager->earliestAffordableFrame(step.minerals + spentMinerals, step.gas + spentGas);
+        if (affordableFrame > frame) {
+            if (i == cursor && affordableFrame != ResourceManager::NeverAffordable) {
+                reservation = resourceManager->reserve(affordableFrame, step.minerals, step.gas);
+                prepare(step, affordableFrame);
+            }
+            continue;
+        }
+
+        if (!canExecute(step) || !execute(step)) { continue; }
+
+        step.done = true;
+        if (step.kind == BuildStep::Train) {
+            spentMinerals += step.minerals;
+            spentGas += step.gas;
+        }
     }
 }
 
-void BuildOrder::onStart()
+void BuildOrder::onStart(MapTools& mapTools, const TerrainAnalyzer& terrain)
 {
-    // Asumiendo que basePosition es la posicin donde quieres construir tus estructuras
-    BWAPI::TilePosition basePosition = BWAPI::Broodwar->self()->getStartLocation(); // Establece tu posicin inicial aqu
-    basePosition = BWAPI::Broodwar->getBuildLocation(BWAPI::UnitTypes::Terran_Barracks, basePosition);
-    // Construir SCV (4 veces para tener 4 SCVs adicionales)
-    for (int i = 0; i < 4; ++i) {
-        addTrainAction(BWAPI::UnitTypes::Terran_SCV, -1);  // El -1 significa que no hay un trigger de suministro especfico
+    map = &mapTools;
+    steps.clear();
+    cursor = 0;
+    reservation = -1;
+    builder = nullptr;
+    builderTile = BWAPI::TilePositions::None;
+    nextSearchFrame = 0;
+
+    // Las posiciones salen del analisis del terreno: los Supply Depot detras de la base, del lado
+    // opuesto a los minerales, y los edificios de produccion a medio camino hacia la salida de la
+    // base. Los pasos de construccion buscan el lugar libre mas cercano a estas semillas.
+    BWAPI::TilePosition supplyPosition = BWAPI::Broodwar->self()->getStartLocation();
+    BWAPI::TilePosition productionPosition = supplyPosition;
+
+    const BaseLocation* mainBase = terrain.getStartingBase();
+    if (mainBase && !mainBase->minerals.empty()) {
+        BWAPI::Position mineralCenter(0, 0);
+        for (auto& mineral : mainBase->minerals) { mineralCenter += mineral->getInitialPosition(); }
+        mineralCenter /= (int)mainBase->minerals.size();
+
+        // 6 tiles desde el centro del Command Center, alejandose de los minerales
+        const BWAPI::Position away = mainBase->depotCenter - mineralCenter;
+        const double length = std::max(1.0, away.getLength());
+        const BWAPI::Position offset((int)(away.x * 192 / length), (int)(away.y * 192 / length));
+        supplyPosition = BWAPI::TilePosition(mainBase->depotCenter + offset).makeValid();
+
+        const Chokepoint* mainChoke = terrain.getMainChoke();
+        productionPosition = mainChoke
+            ? BWAPI::TilePosition((mainBase->depotCenter + BWAPI::Position(mainChoke->center)) / 2)
+            : supplyPosition;
     }
 
-    // Construir refineria de vespeno
+    // La refineria va sobre el geiser mas cercano a la base inicial
     BWAPI::TilePosition startPosition = BWAPI::Broodwar->self()->getStartLocation(); // Obtener la posicin inicial
-    BWAPI::Unitset vespeneGeysers = Tools::getUnitsOfTypes(BWAPI::UnitTypes::Resource_Vespene_Geyser);
-    BWAPI::Unit closestVespeneGeyser = Tools::GetClosestUnitTo(BWAPI::Position(startPosition), vespeneGeysers);
-    if (closestVespeneGeyser) {
-        BWAPI::TilePosition vespeneBuildPos = closestVespeneGeyser->getTilePosition();
-        addBuildAction(BWAPI::UnitTypes::Terran_Refinery, vespeneBuildPos);
+    BWAPI::Unit closestVespeneGeyser = nullptr;
+    int closestGeyserDistance = std::numeric_limits<int>::max();
+    for (auto& geyser : Tools::eachUnitOfTypes<BWAPI::UnitTypes::Enum::Resource_Vespene_Geyser>()) {
+        const int distance = geyser->getDistance(BWAPI::Position(startPosition));
+        if (distance < closestGeyserDistance) {
+            closestVespeneGeyser = geyser;
+            closestGeyserDistance = distance;
+        }
     }
 
+    anchors[BuildScript::Main] = startPosition;
+    anchors[BuildScript::Supply] = supplyPosition;
+    anchors[BuildScript::Production] = productionPosition;
+    anchors[BuildScript::Geyser] = closestVespeneGeyser ? closestVespeneGeyser->getTilePosition() : BWAPI::TilePositions::None;
 
-    // Construir un Supply Depot despus del cuarto SCV
-    addBuildAction(BWAPI::UnitTypes::Terran_Supply_Depot, basePosition, 8 );  // Este se inicia cuando llegas a 8 de suministro
-
-
-    // Construir SCV (2)
-    for (int i = 0; i < 2; ++i) {
-        addTrainAction(BWAPI::UnitTypes::Terran_SCV, -1);  // El -1 significa que no hay un trigger de suministro especfico
+    // El build order se lee de un archivo para poder cambiar de estrategia sin recompilar; si no
+    // esta, se usa el que viene con el bot
+    std::string script = BuildScript::load("bwapi-data/read/buildorder.txt");
+    if (script.empty()) {
+        script = BuildScript::DefaultScript;
     }
 
-    // Construir un Barracks despus del Supply Depot
-    basePosition.y += 2;
-    addBuildAction(BWAPI::UnitTypes::Terran_Barracks, basePosition, 10);
+    BuildScript::Program program = BuildScript::compile(script, anchors);
+    steps = std::move(program.steps);
+    goal = std::move(program.goal);
+    strategy = program.strategy;
+}
 
-    // Construir un Barracks despus del Supply Depot
-    basePosition.y += 2;
-    addBuildAction(BWAPI::UnitTypes::Terran_Barracks, basePosition, 10);
+bool BuildOrder::needsPlan() const
+{
+    if (goal.empty() || BWAPI::Broodwar->getFrameCount() < nextSearchFrame) { return false; }
 
-    // Continuar construyendo SCVs
-    for (int i = 0; i < 5; ++i) {
-        addTrainAction(BWAPI::UnitTypes::Terran_SCV, -1);
+    for (size_t i = cursor; i < steps.size(); ++i) {
+        if (!steps[i].done) { return false; }
     }
 
-    basePosition.y += 2;
-    // Construir otro Supply Depot para aumentar el suministro
-    addBuildAction(BWAPI::UnitTypes::Terran_Supply_Depot,basePosition);
- 
-    basePosition.y += 2;
-    // Construir un Academy despus de tener suficientes SCVs
-    addBuildAction(BWAPI::UnitTypes::Terran_Academy,basePosition);
- 
-    basePosition.y -= 15;
-    // Construir otro Supply Depot para aumentar el suministro
-    addBuildAction(BWAPI::UnitTypes::Terran_Supply_Depot,basePosition);
- 
-    basePosition.y -= 2;
-    // Construir otro Supply Depot para aumentar el suministro
-    addBuildAction(BWAPI::UnitTypes::Terran_Supply_Depot,basePosition);
-    
-    // Entrenar 10 Marines
-    for (int i = 0; i < 10; ++i) {
-        addTrainAction(BWAPI::UnitTypes::Terran_Marine, -1);
+    UnitCensus* census = UnitCensus::getInstance();
+    for (auto& [type, count] : goal) {
+        if (census->total(type) < count) { return true; }
     }
+    return false;
+}
+
+void BuildOrder::setPlan(const std::vector<BWAPI::UnitType>& plan)
+{
+    // Si el plan sale vacio o no alcanza, se vuelve a buscar mas tarde y no en cada frame
+    nextSearchFrame = BWAPI::Broodwar->getFrameCount() + SearchInterval;
 
-    // Entrenar 2 Medics
-    for (int i = 0; i < 2; ++i) {
-        addTrainAction(BWAPI::UnitTypes::Terran_Medic, -1);
+    releaseBuilder();
+    steps.erase(steps.begin() + cursor, steps.end());
+    for (auto& type : plan) {
+        steps.push_back(BuildScript::makeStep(type, anchors));
     }
-}
\ No newline at end of file
+}
@@ -1,18 +1,57 @@
 #pragma once
 
 #include "MapTools.h"
+#include "TerrainAnalyzer.h"
+#include "ThreatMap.h"
+#include "ThreadPool.h"
+#include "FrameScheduler.h"
+#include "WorkerRegistry.h"
+#include "BuildScript.h"
+#include "BuildOrderSearch.h"
 #include <vector>
-#include <queue>
 #include <BWAPI.h>
 #include <memory>
+#include <array>
+#include <limits>
 
 class ResourceManager {
+public:
+    static const int IncomeSamples = 256;                       // muestras de lo recolectado, una por frame
+    static const int MinIncomeSpan = 24;                        // frames de muestras antes de confiar en ellas
+    static constexpr double MineralsPerWorkerFrame = 0.045;     // estimacion inicial, unos 65 por minuto por trabajador
+    static const int NeverAffordable = std::numeric_limits<int>::max();
+
 private:
     static ResourceManager* instance;
 
+    struct IncomeSample {
+        int frame;
+        int minerals;   // total recolectado hasta ese frame
+        int gas;
+    };
+
+    struct Reservation {
+        int id;
+        int frame;      // frame en el que se piensa gastar
+        int minerals;
+        int gas;
+    };
+
     int committedMinerals = 0;
     int committedGas = 0;
 
+    // Anillo con lo recolectado en los ultimos frames; el ingreso es la pendiente entre la muestra
+    // mas vieja y la mas nueva
+    std::array<IncomeSample, IncomeSamples> incomeSamples{};
+    int incomeNext = 0;
+    int incomeCount = 0;
+    double mineralRate = 0;     // por frame
+    double gasRate = 0;
+
+    // Gastos planeados a futuro, ordenados por frame
+    std::vector<Reservation> reservations;
+    int nextReservationId = 0;
+
     // Constructor privado
     ResourceManager() : committedMinerals(0), committedGas(0) {}
 
@@ -55,6 +94,22 @@ public:
         return BWAPI::Broodwar->self()->gas() - committedGas;
     }
 
+    // Toma la muestra de ingreso del frame y recalcula el ingreso por frame
+    void onFrame();
+
+    double getMineralRate() const { return mineralRate; }
+    double getGasRate() const { return gasRate; }
+
+    // Linea de tiempo de reservas: gastos que se piensan hacer en un frame futuro. Devuelve el id
+    // con el que se cancela la reserva; cancelar un id que ya no existe no hace nada.
+    int reserve(int frame, int minerals, int gas);
+    void cancelReservation(int id);
+    int getReservationCount() const { return (int)reservations.size(); }
+
+    // Primer frame en el que se puede gastar esta cantidad sin dejar sin fondos a ninguna reserva,
+    // suponiendo que el ingreso sigue igual. NeverAffordable si sin ingreso nunca alcanza.
+    int earliestAffordableFrame(int minerals, int gas) const;
+
     void onUnitComplete(BWAPI::Unit unit) {
         if (!unit->getType().isBuilding()) { return; }
         releaseMinerals(unit->getType().mineralPrice());
@@ -79,11 +134,22 @@ class WorkerManager {
 private:
 	static WorkerManager* instance;
 
-    std::vector<BWAPI::Unit> workers; // Lista de todos los trabajadores
-	std::map<BWAPI::Unit, BWAPI::Unit> workerAssignments; // Relaciones de trabajadores con la unidad con la que estan trabajando (ej: mineraField)
-    std::map<BWAPI::Unit, BWAPI::TilePosition> workerBuildTargets; // Destinos de construccin para los trabajadores
+    WorkerRegistry workers; // Todos los trabajadores con su rol, recurso asignado y destino de construccin
+
+    // Trabajadores que pasaron a Idle desde el ltimo frame. Puede tener repetidos o trabajadores
+    // que ya se reasignaron: se descartan al sacarlos si ya no estan en Idle.
+    std::vector<BWAPI::Unit> idleQueue;
+
+    // Edificios terran en construccin con el SCV que los construye (edificio, trabajador)
+    std::vector<std::pair<BWAPI::Unit, BWAPI::Unit>> constructions;
+
+    // Siguiente trabajador que revisa el barrido de reconciliacin
+    size_t sweepCursor = 0;
+
 	void sendIdleWorkersToWork();
-	void manageConstructionWorkers();
+	void setIdle(BWAPI::Unit worker); // Pasa el trabajador a Idle y lo encola para reasignarlo
+	void releaseMinerals(BWAPI::Unit worker); // Libera el parche de mineral del trabajador en el MineralIndex
+	BWAPI::Unit findBuilderOf(BWAPI::Unit building);
 public:
 	// Elimina los mtodos de copia
 	WorkerManager(WorkerManager& other) = delete;
@@ -96,6 +162,9 @@ public:
 	void onStart();
 	void onFrame();
 	void onUnitCreate(BWAPI::Unit unit);	
+	void onUnitComplete(BWAPI::Unit unit);
+	void onUnitDestroy(BWAPI::Unit unit);
+	void onUnitMorph(BWAPI::Unit unit);
 
 	// Asignacin y gestin de recursos
     void assignWorkerToMinerals(BWAPI::Unit worker);
@@ -110,6 +179,19 @@ public:
     void assignWorkerToBuild(BWAPI::Unit worker, BWAPI::UnitType buildingType, BWAPI::TilePosition buildPosition);
     void onBuildingCompletion(BWAPI::Unit building); // Llamado cuando un edificio se completa
 
+    // Manda al trabajador hacia el lugar antes de que alcance el dinero; queda como constructor
+    void sendBuilderAhead(BWAPI::Unit worker, BWAPI::UnitType buildingType, BWAPI::TilePosition buildPosition);
+    bool isAssignedToBuild(BWAPI::Unit worker, BWAPI::UnitType buildingType) const;
+
+    // Devuelve a Idle al constructor enviado por adelantado si todavia no recibio la orden de construir
+    void cancelBuilderAhead(BWAPI::Unit worker);
+    static const int BuilderWaitFrames = 24 * 30; // Lo mas que el barrido deja esperar a un constructor enviado por adelantado
+
+    // Revisa unos pocos trabajadores por llamada buscando los que quedaron ociosos sin que llegara
+    // un evento (orden de construccin fallida, parche perdido...). Devuelve true al terminar la vuelta.
+    static const int SweepBatch = 16;
+    bool reconcileWorkers(FrameScheduler::Clock::time_point deadline);
+
     // Defensa y proteccin
     void protectWorkers();
     void evacuateWorkers(BWAPI::Position dangerZone);
@@ -133,68 +215,65 @@ public:
 };
 
 
-class Action
-{
-protected:
-	BWAPI::UnitType type;
-	int supplyTrigger;
-	int mineralCost;
-	int gasCost;
-public:
-	Action(BWAPI::UnitType type, int supplyTrigger);
-	virtual bool canExecute()=0;
-	virtual void execute() = 0;
-	int getSupplyTrigger();
-	int getMineralCost();
-	int getGasCost();
-};
-
-
-class BuildAction : public Action
+// Ejecuta la tabla de pasos compilada desde el script de build order (ver BuildScript.h).
+// El cursor apunta al primer paso sin hacer; los Lookahead pasos siguientes pueden adelantarse
+// si el del cursor espera por otra cosa que no sea dinero (suministro, una estructura libre) o si
+// gastar en ellos no retrasa al del cursor, por ejemplo entrenar un SCV mientras se junta para
+// un Supply Depot.
+class BuildOrder
 {
-	BWAPI::TilePosition buildPosition;
-public:
-	
-	
-	BuildAction(BWAPI::UnitType type, int supplyTrigger, BWAPI::TilePosition buildPosition);
-	
-	virtual bool canExecute() override;
-	virtual void execute() override;
-};
+	std::vector<BuildStep> steps; // Tabla de pasos, contigua y sin punteros
+	size_t cursor = 0; // Primer paso sin hacer
+	MapTools* map = nullptr;
+	int reservation = -1; // Reserva de recursos del paso del cursor en el ResourceManager
+	BWAPI::Unit builder = nullptr; // Trabajador enviado por adelantado para el paso del cursor
+	size_t builderStep = 0; // Paso para el que se mando el builder
+	BWAPI::TilePosition builderTile = BWAPI::TilePositions::None; // Lugar resuelto para ese paso, adonde va el builder
+	std::string strategy; // Nombre de la estrategia compilada
+	BuildScript::Anchors anchors; // Semillas de construccion, para los pasos que agrega la busqueda
+	BuildScript::Goal goal; // Unidades a tener cuando se acaban los pasos
+	int nextSearchFrame = 0; // No pedir otra busqueda antes de este frame
+
+	bool canExecute(const BuildStep& step) const;
+	bool execute(const BuildStep& step);
+	bool executeBuild(const BuildStep& step);
+	bool executeTrain(const BuildStep& step);
+	void prepare(const BuildStep& step, int affordableFrame);
+	void releaseBuilder();
+	BWAPI::TilePosition findBuildTile(const BuildStep& step) const;
+	BWAPI::Unit findTrainingStructure(BWAPI::UnitType type) const;
 
-
-class TrainAction : public Action
-{
 public:
+	static const int Lookahead = 4; // Pasos que se miran adems del cursor
+	static const int SearchInterval = 24 * 10; // Frames entre una busqueda y la siguiente
 
-	TrainAction(BWAPI::UnitType type, int supplyTrigger);
-	
-	virtual bool canExecute() override;
-	virtual void execute() override;
-	BWAPI::Unit findTrainingStructure();
-};
-
+	// Ejecuta los pasos que se puedan en este frame
+	void onFrame();
+	void onStart(MapTools& mapTools, const TerrainAnalyzer& terrain);
 
-class BuildOrder
-{
-	std::queue<std::unique_ptr<Action>> actions;
+	const std::string& getStrategy() const { return strategy; }
+	size_t getCursor() const { return cursor; }
+	size_t size() const { return steps.size(); }
 
-public:
-	void addBuildAction(BWAPI::UnitType unitType, BWAPI::TilePosition buildPosition, int supplyTrigger = -1);
-	void addTrainAction(BWAPI::UnitType unitType, int supplyTrigger = -1);
-	
-	// execute next action on frame
-	void onFrame();
-	void onStart();
-	
+	// Si ya se hicieron todos los pasos y falta algo del objetivo, hay que buscar como llegar
+	bool needsPlan() const;
+	const BuildScript::Goal& getGoal() const { return goal; }
 
+	// Agrega los tipos del plan de BuildOrderSearch como pasos, en orden
+	void setPlan(const std::vector<BWAPI::UnitType>& plan);
 };
 
 class StarterBot
 {
 	MapTools m_mapTools;
+	BuildOrderSearch m_buildSearch; // Antes que el pool para que sus tareas terminen antes de destruirla
+	ThreadPool m_threadPool;
+	TerrainAnalyzer m_terrain;
+	ThreatMap m_threatMap;
+	FrameScheduler m_scheduler;
 	BuildOrder buildOrder;
     bool gameJustStarted;
+    bool m_drawTerrain = false;
 
 	// helper functions to get you started with bot programming and learn the API
 	void sendIdleWorkersToMinerals(); // Dave
@@ -204,6 +283,8 @@ class StarterBot
 	void drawDebugInformation();// modify
 	void drawPositionsOfAllUnits(); // 
 	void drawResourceManagerInfo();
+	void drawBuildOrderInfo();
+	void registerFrameTasks();
 public:
 
 	StarterBot();
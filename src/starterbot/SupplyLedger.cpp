@@ -0,0 +1,242 @@
+#include "SupplyLedger.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+SupplyLedger* SupplyLedger::instance = nullptr;
+
+SupplyLedger* SupplyLedger::getInstance()
+{
+    if (instance == nullptr) {
+        instance = new SupplyLedger();
+    }
+    return instance;
+}
+
+void SupplyLedger::onStart()
+{
+    m_pending.clear();
+    m_orders.clear();
+    m_producers.clear();
+    m_pendingSupply = 0;
+    m_orderedSupply = 0;
+
+    for (auto & unit : BWAPI::Broodwar->self()->getUnits())
+    {
+        if (unit->isCompleted()) { onUnitComplete(unit); }
+        else                     { onUnitCreate(unit); }
+    }
+}
+
+// Drops the orders whose worker was killed, was given something else to do, or never got to
+// place the building
+void SupplyLedger::onFrame()
+{
+    PROFILE_SCOPE("SupplyLedger::onFrame");
+
+    const int frame = BWAPI::Broodwar->getFrameCount();
+
+    for (size_t i = m_orders.size(); i-- > 0;)
+    {
+        const Order & order = m_orders[i];
+        const BWAPI::UnitCommand & command = order.worker->getLastCommand();
+
+        if (!order.worker->exists() ||
+            command.getType() != BWAPI::UnitCommandTypes::Build ||
+            command.getUnitType() != order.type ||
+            frame - order.frame > OrderTimeoutFrames)
+        {
+            removeOrder(i);
+        }
+    }
+}
+
+bool SupplyLedger::isOurs(BWAPI::Unit unit) const
+{
+    return unit && unit->getPlayer() == BWAPI::Broodwar->self();
+}
+
+void SupplyLedger::addPending(BWAPI::Unit unit, int supply)
+{
+    if (supply <= 0) { return; }
+    if (std::any_of(m_pending.begin(), m_pending.end(), [unit](const Pending & p) { return p.unit == unit; })) { return; }
+
+    m_pending.push_back({ unit, supply, BWAPI::Broodwar->getFrameCount() + unit->getRemainingBuildTime() });
+    m_pendingSupply += supply;
+}
+
+void SupplyLedger::removePending(BWAPI::Unit unit)
+{
+    for (size_t i = 0; i < m_pending.size(); ++i)
+    {
+        if (m_pending[i].unit != unit) { continue; }
+
+        m_pendingSupply -= m_pending[i].supply;
+        m_pending[i] = m_pending.back();
+        m_pending.pop_back();
+        return;
+    }
+}
+
+void SupplyLedger::removeOrder(size_t i)
+{
+    m_orderedSupply -= m_orders[i].type.supplyProvided();
+    m_orders[i] = m_orders.back();
+    m_orders.pop_back();
+}
+
+// A supply provider was placed: it moves from the ordered supply to the pending supply. The order
+// it came from is the one of the worker building it, or else the oldest order of the same type
+// (probes don't stay attached to what they warp in).
+void SupplyLedger::onUnitCreate(BWAPI::Unit unit)
+{
+    if (!isOurs(unit) || unit->isCompleted()) { return; }
+
+    const BWAPI::UnitType type = unit->getType();
+    if (type.supplyProvided() <= 0) { return; }
+
+    addPending(unit, type.supplyProvided());
+
+    const BWAPI::Unit builder = unit->getBuildUnit();
+    size_t match = m_orders.size();
+    for (size_t i = 0; i < m_orders.size(); ++i)
+    {
+        if (m_orders[i].type != type) { continue; }
+        if (m_orders[i].worker == builder) { match = i; break; }
+        if (match == m_orders.size() || m_orders[i].frame < m_orders[match].frame) { match = i; }
+    }
+
+    if (match < m_orders.size()) { removeOrder(match); }
+}
+
+// Zerg supply comes from eggs turning into overlords and drones turning into hatcheries
+void SupplyLedger::onUnitMorph(BWAPI::Unit unit)
+{
+    if (!isOurs(unit)) { return; }
+
+    removePending(unit);
+
+    const BWAPI::UnitType type = unit->getType();
+    if (type == BWAPI::UnitTypes::Zerg_Egg)
+    {
+        addPending(unit, unit->getBuildType().supplyProvided());
+    }
+    else if (type == BWAPI::UnitTypes::Zerg_Hatchery)
+    {
+        onUnitCreate(unit);
+    }
+}
+
+void SupplyLedger::onUnitComplete(BWAPI::Unit unit)
+{
+    removePending(unit);
+
+    const BWAPI::UnitType type = unit->getType();
+    if (isOurs(unit) && type.isBuilding() && type.canProduce() &&
+        std::find(m_producers.begin(), m_producers.end(), unit) == m_producers.end())
+    {
+        m_producers.push_back(unit);
+    }
+}
+
+void SupplyLedger::onUnitDestroy(BWAPI::Unit unit)
+{
+    removePending(unit);
+
+    for (size_t i = m_orders.size(); i-- > 0;)
+    {
+        if (m_orders[i].worker == unit) { removeOrder(i); }
+    }
+
+    m_producers.erase(std::remove(m_producers.begin(), m_producers.end(), unit), m_producers.end());
+}
+
+void SupplyLedger::onBuildCommand(BWAPI::Unit worker, BWAPI::UnitType type)
+{
+    if (!worker || type.supplyProvided() <= 0) { return; }
+
+    // a new order for the same worker replaces the old one
+    for (size_t i = m_orders.size(); i-- > 0;)
+    {
+        if (m_orders[i].worker == worker) { removeOrder(i); }
+    }
+
+    m_orders.push_back({ worker, type, BWAPI::Broodwar->getFrameCount() });
+    m_orderedSupply += type.supplyProvided();
+}
+
+int SupplyLedger::total(bool inProgress) const
+{
+    const int supply = BWAPI::Broodwar->self()->supplyTotal();
+    if (!inProgress) { return supply; }
+
+    return std::min(MaxSupply, supply + m_pendingSupply + m_orderedSupply);
+}
+
+int SupplyLedger::free() const
+{
+    return BWAPI::Broodwar->self()->supplyTotal() - BWAPI::Broodwar->self()->supplyUsed();
+}
+
+// Supply the producer will take in the given number of frames: the units waiting in its queue as
+// they start, then the last of them over and over. Units take their supply when they start
+// training, so the one in training is already counted in supplyUsed.
+int SupplyLedger::producerDemand(BWAPI::Unit producer, int frames) const
+{
+    if (!producer->isTraining()) { return 0; }
+
+    const BWAPI::UnitType::list queue = producer->getTrainingQueue();
+    if (queue.empty()) { return 0; }
+
+    int demand = 0;
+    int start = producer->getRemainingTrainTime();
+    for (size_t i = 1; i < queue.size(); ++i)
+    {
+        if (start > frames) { return demand; }
+
+        demand += queue[i].supplyRequired();
+        start += queue[i].buildTime();
+    }
+
+    const BWAPI::UnitType last = queue.back();
+    if (start <= frames && last.buildTime() > 0)
+    {
+        demand += last.supplyRequired() * ((frames - start) / last.buildTime() + 1);
+    }
+
+    return demand;
+}
+
+int SupplyLedger::projectedFree(int frames) const
+{
+    const int frame = BWAPI::Broodwar->getFrameCount();
+    const int until = frame + frames;
+
+    int supply = BWAPI::Broodwar->self()->supplyTotal();
+    for (auto & pending : m_pending)
+    {
+        if (pending.completionFrame <= until) { supply += pending.supply; }
+    }
+    for (auto & order : m_orders)
+    {
+        if (order.frame + OrderTravelFrames + order.type.buildTime() <= until) { supply += order.type.supplyProvided(); }
+    }
+
+    int demand = BWAPI::Broodwar->self()->supplyUsed();
+    for (auto & producer : m_producers)
+    {
+        demand += producerDemand(producer, frames);
+    }
+
+    return std::min(MaxSupply, supply) - demand;
+}
+
+int SupplyLedger::pendingSupply() const
+{
+    return m_pendingSupply;
+}
+
+int SupplyLedger::orderedSupply() const
+{
+    return m_orderedSupply;
+}
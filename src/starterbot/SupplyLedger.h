@@ -0,0 +1,85 @@
+#pragma once
+
+#include <BWAPI.h>
+#include <vector>
+
+// Keeps track of the supply that is on its way, from unit events and from the build commands we
+// issue, so asking how much supply we will have doesn't walk our units. Everything is in BWAPI
+// supply units (twice what the game shows).
+//
+// Besides the current numbers it projects the free supply a number of frames ahead: supply
+// providers finish at known frames, and each of our production structures is assumed to work
+// through its training queue and keep training the last unit in it.
+class SupplyLedger
+{
+public:
+
+    static const int MaxSupply = 400;
+
+    // frames a worker is allowed to take to reach a build site before its order is dropped, and
+    // the travel time assumed when projecting when an ordered provider finishes
+    static const int OrderTimeoutFrames = 24 * 30;
+    static const int OrderTravelFrames  = 24 * 5;
+
+private:
+
+    struct Pending
+    {
+        BWAPI::Unit     unit;
+        int             supply;
+        int             completionFrame;
+    };
+
+    struct Order
+    {
+        BWAPI::Unit     worker;
+        BWAPI::UnitType type;
+        int             frame;
+    };
+
+    static SupplyLedger* instance;
+
+    std::vector<Pending>        m_pending;      // our supply providers under construction
+    std::vector<Order>          m_orders;       // providers ordered but not started yet
+    std::vector<BWAPI::Unit>    m_producers;    // our completed structures that train units
+    int                         m_pendingSupply = 0;
+    int                         m_orderedSupply = 0;
+
+    SupplyLedger() {}
+
+    bool    isOurs(BWAPI::Unit unit) const;
+    void    addPending(BWAPI::Unit unit, int supply);
+    void    removePending(BWAPI::Unit unit);
+    void    removeOrder(size_t i);
+    int     producerDemand(BWAPI::Unit producer, int frames) const;
+
+public:
+
+    SupplyLedger(SupplyLedger& other) = delete;
+    void operator=(const SupplyLedger&) = delete;
+
+    static SupplyLedger* getInstance();
+
+    void    onStart();
+    void    onFrame();
+    void    onUnitCreate(BWAPI::Unit unit);
+    void    onUnitMorph(BWAPI::Unit unit);
+    void    onUnitComplete(BWAPI::Unit unit);
+    void    onUnitDestroy(BWAPI::Unit unit);
+
+    // called when we order a worker to build something, so the supply counts before the
+    // building is placed
+    void    onBuildCommand(BWAPI::Unit worker, BWAPI::UnitType type);
+
+    // supply we have now, optionally with what is under construction or ordered
+    int     total(bool inProgress = false) const;
+
+    // supply we can use right now
+    int     free() const;
+
+    // free supply expected in the given number of frames, negative if we will be supply blocked
+    int     projectedFree(int frames) const;
+
+    int     pendingSupply() const;
+    int     orderedSupply() const;
+};
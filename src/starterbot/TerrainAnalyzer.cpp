@@ -0,0 +1,472 @@
+#include "TerrainAnalyzer.h"
+#include "Profiler.h"
+#include "MapTools.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <map>
+
+namespace
+{
+    // mineral fields with less than this are path blockers, not part of a base
+    const int MinBaseMineralAmount  = 64;
+
+    // resources closer than this many tiles to each other end up in the same base
+    const int ClusterDistance       = 10;
+    const int MinClusterSize        = 3;
+
+    // how far from its resources we look for a depot tile, and how far a start location may
+    // be from the tile we picked for it to be treated as the same base
+    const int DepotSearchRadius     = 10;
+    const int StartLocationDistance = 8;
+
+    // watershed areas whose widest point is narrower than this many walk tiles, or that cover
+    // fewer walk tiles than this, are merged into their neighbour instead of being kept apart
+    const int MinAreaPeak           = 6;
+    const int MinAreaSize           = 400;
+
+    int Distance(const BWAPI::TilePosition & a, const BWAPI::TilePosition & b)
+    {
+        return std::max(std::abs(a.x - b.x), std::abs(a.y - b.y));
+    }
+
+    int Find(std::vector<int> & parent, int a)
+    {
+        while (parent[a] != a)
+        {
+            parent[a] = parent[parent[a]];
+            a = parent[a];
+        }
+
+        return a;
+    }
+}
+
+TerrainAnalyzer::TerrainAnalyzer()
+{
+
+}
+
+void TerrainAnalyzer::analyze(const MapTools & map, ThreadPool & pool)
+{
+    PROFILE_SCOPE("TerrainAnalyzer::analyze");
+
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    m_bases.clear();
+    m_chokepoints.clear();
+    m_startBase = -1;
+    m_mainChoke = -1;
+
+    // everything the tasks need from BWAPI is copied out here, on the main thread
+    std::vector<Resource> resources;
+    for (auto & mineral : BWAPI::Broodwar->getStaticMinerals())
+    {
+        if (mineral->getInitialResources() < MinBaseMineralAmount) { continue; }
+        resources.push_back({ mineral, mineral->getInitialType(), mineral->getInitialTilePosition() });
+    }
+
+    for (auto & geyser : BWAPI::Broodwar->getStaticGeysers())
+    {
+        resources.push_back({ geyser, geyser->getInitialType(), geyser->getInitialTilePosition() });
+    }
+
+    std::vector<std::vector<Resource>> clusters;
+    clusterResources(resources, clusters);
+
+    m_bases.resize(clusters.size());
+    for (size_t i = 0; i < clusters.size(); ++i)
+    {
+        for (auto & resource : clusters[i])
+        {
+            if (resource.type.isMineralField()) { m_bases[i].minerals.push_back(resource.unit); }
+            else                                { m_bases[i].geysers.push_back(resource.unit); }
+        }
+    }
+
+    // the watershed is one long sequential sweep, so it gets a task of its own while the
+    // depot searches, one per base, run next to it
+    const Grid<uint16_t> & clearance = map.clearance();
+    pool.submit([this, &clearance] { computeAreas(clearance); });
+
+    for (size_t i = 0; i < clusters.size(); ++i)
+    {
+        pool.submit([this, &map, &clusters, i] { findDepot(map, clusters[i], m_bases[i]); });
+    }
+
+    pool.wait();
+
+    m_bases.erase(std::remove_if(m_bases.begin(), m_bases.end(),
+        [](const BaseLocation & base) { return base.depotTile == BWAPI::TilePositions::None; }), m_bases.end());
+
+    // start locations are the depot tiles the map maker chose, prefer them over our own
+    for (auto & startLocation : BWAPI::Broodwar->getStartLocations())
+    {
+        BaseLocation * closest = nullptr;
+        for (auto & base : m_bases)
+        {
+            if (!closest || Distance(base.depotTile, startLocation) < Distance(closest->depotTile, startLocation))
+            {
+                closest = &base;
+            }
+        }
+
+        if (closest && Distance(closest->depotTile, startLocation) <= StartLocationDistance)
+        {
+            closest->depotTile = startLocation;
+            closest->isStartLocation = true;
+        }
+    }
+
+    const BWAPI::TilePosition myStart = BWAPI::Broodwar->self()->getStartLocation();
+    for (size_t i = 0; i < m_bases.size(); ++i)
+    {
+        BaseLocation & base = m_bases[i];
+        base.depotCenter = BWAPI::Position(base.depotTile) + BWAPI::Position(64, 48);
+        base.area = getArea(BWAPI::WalkPosition(base.depotCenter));
+
+        if (base.depotTile == myStart) { m_startBase = (int)i; }
+    }
+
+    findMainChoke(map);
+
+    m_elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+// Single linkage clustering: any two resources within ClusterDistance tiles of each other are
+// in the same cluster. Clusters too small to be a base, or without minerals, are dropped.
+void TerrainAnalyzer::clusterResources(const std::vector<Resource> & resources, std::vector<std::vector<Resource>> & clusters) const
+{
+    std::vector<int> parent(resources.size());
+    for (size_t i = 0; i < resources.size(); ++i) { parent[i] = (int)i; }
+
+    for (size_t i = 0; i < resources.size(); ++i)
+    {
+        for (size_t j = i + 1; j < resources.size(); ++j)
+        {
+            if (Distance(resources[i].tile, resources[j].tile) <= ClusterDistance)
+            {
+                parent[Find(parent, (int)j)] = Find(parent, (int)i);
+            }
+        }
+    }
+
+    std::map<int, std::vector<Resource>> groups;
+    for (size_t i = 0; i < resources.size(); ++i)
+    {
+        groups[Find(parent, (int)i)].push_back(resources[i]);
+    }
+
+    for (auto & [root, group] : groups)
+    {
+        const bool hasMinerals = std::any_of(group.begin(), group.end(), [](const Resource & r) { return r.type.isMineralField(); });
+        if ((int)group.size() < MinClusterSize || !hasMinerals) { continue; }
+
+        clusters.push_back(std::move(group));
+    }
+}
+
+// Tries every depot footprint around the cluster that fits on depot buildable tiles and keeps
+// the one with the smallest total distance to the resources. Only reads MapTools, so any number
+// of these can run at once.
+void TerrainAnalyzer::findDepot(const MapTools & map, const std::vector<Resource> & cluster, BaseLocation & base) const
+{
+    const BWAPI::UnitType depot = BWAPI::UnitTypes::Terran_Command_Center;
+
+    int minX = std::numeric_limits<int>::max(), minY = std::numeric_limits<int>::max();
+    int maxX = std::numeric_limits<int>::min(), maxY = std::numeric_limits<int>::min();
+    for (auto & resource : cluster)
+    {
+        minX = std::min(minX, resource.tile.x);
+        minY = std::min(minY, resource.tile.y);
+        maxX = std::max(maxX, resource.tile.x + resource.type.tileWidth());
+        maxY = std::max(maxY, resource.tile.y + resource.type.tileHeight());
+    }
+
+    base.depotTile = BWAPI::TilePositions::None;
+    long long bestScore = std::numeric_limits<long long>::max();
+
+    for (int y = minY - DepotSearchRadius; y <= maxY + DepotSearchRadius; ++y)
+    {
+        for (int x = minX - DepotSearchRadius; x <= maxX + DepotSearchRadius; ++x)
+        {
+            bool fits = true;
+            for (int dy = 0; dy < depot.tileHeight() && fits; ++dy)
+            {
+                for (int dx = 0; dx < depot.tileWidth() && fits; ++dx)
+                {
+                    fits = map.isDepotBuildableTile(x + dx, y + dy);
+                }
+            }
+
+            if (!fits) { continue; }
+
+            const BWAPI::Position center(x * 32 + depot.tileWidth() * 16, y * 32 + depot.tileHeight() * 16);
+            long long score = 0;
+            for (auto & resource : cluster)
+            {
+                const BWAPI::Position resourceCenter(resource.tile.x * 32 + resource.type.tileWidth() * 16,
+                                                     resource.tile.y * 32 + resource.type.tileHeight() * 16);
+                score += center.getApproxDistance(resourceCenter);
+            }
+
+            if (score < bestScore)
+            {
+                bestScore = score;
+                base.depotTile = BWAPI::TilePosition(x, y);
+            }
+        }
+    }
+}
+
+// Watershed over the clearance layer. Walk tiles are visited from the most open to the most
+// enclosed; a tile with no labelled neighbour starts a new area, and a tile that touches two
+// areas is where they meet. Areas that are small, or that meet at a point nearly as open as
+// their own widest point, are merged. Everything else meets at a saddle of the clearance field,
+// which is the narrowest point between the two areas: a chokepoint.
+void TerrainAnalyzer::computeAreas(const Grid<uint16_t> & clearance)
+{
+    const int w = (int)clearance.width();
+    const int h = (int)clearance.height();
+
+    m_areas = Grid<int>(w, h, -1);
+
+    // counting sort of the walkable walk tiles by clearance, highest first
+    int maxClearance = 0;
+    for (int y = 0; y < h; ++y)
+    {
+        for (uint16_t c : clearance.row(y)) { maxClearance = std::max<int>(maxClearance, c); }
+    }
+
+    std::vector<int> start(maxClearance + 2, 0);
+    for (int y = 0; y < h; ++y)
+    {
+        for (uint16_t c : clearance.row(y)) { if (c > 0) { ++start[maxClearance - c + 1]; } }
+    }
+
+    for (size_t i = 1; i < start.size(); ++i) { start[i] += start[i - 1]; }
+
+    std::vector<int> order(start.back());
+    for (int y = 0; y < h; ++y)
+    {
+        const auto row = clearance.row(y);
+        for (int x = 0; x < w; ++x)
+        {
+            if (row[x] > 0) { order[start[maxClearance - row[x]]++] = y * w + x; }
+        }
+    }
+
+    std::vector<int> parent;
+    std::vector<int> peak;
+    std::vector<int> size;
+    std::vector<Frontier> frontiers;
+
+    for (const int index : order)
+    {
+        const int x = index % w;
+        const int y = index / w;
+        const int c = clearance.get(x, y);
+
+        int roots[8];
+        int rootCount = 0;
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                const int nx = x + dx;
+                const int ny = y + dy;
+                if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= w || ny >= h) { continue; }
+
+                const int area = m_areas.get(nx, ny);
+                if (area < 0) { continue; }
+
+                const int root = Find(parent, area);
+                if (std::find(roots, roots + rootCount, root) == roots + rootCount) { roots[rootCount++] = root; }
+            }
+        }
+
+        if (rootCount == 0)
+        {
+            const int area = (int)parent.size();
+            parent.push_back(area);
+            peak.push_back(c);
+            size.push_back(1);
+            m_areas.set(x, y, area);
+            continue;
+        }
+
+        int best = roots[0];
+        for (int i = 1; i < rootCount; ++i)
+        {
+            if (peak[roots[i]] > peak[best]) { best = roots[i]; }
+        }
+
+        for (int i = 0; i < rootCount; ++i)
+        {
+            const int other = roots[i];
+            if (other == best) { continue; }
+
+            const int  smallerPeak = std::min(peak[best], peak[other]);
+            const bool tooSmall    = size[other] < MinAreaSize || size[best] < MinAreaSize;
+            const bool tooNarrow   = smallerPeak < MinAreaPeak;
+            const bool tooOpen     = c * 10 >= smallerPeak * 8;
+
+            if (tooSmall || tooNarrow || tooOpen)
+            {
+                parent[other] = best;
+                size[best] += size[other];
+            }
+            else
+            {
+                frontiers.push_back({ best, other, index, c });
+            }
+        }
+
+        m_areas.set(x, y, best);
+        ++size[best];
+    }
+
+    // number the surviving areas 0..n-1 and relabel every walk tile
+    std::vector<int> label(parent.size(), -1);
+    m_areaCount = 0;
+    for (size_t i = 0; i < parent.size(); ++i)
+    {
+        const int root = Find(parent, (int)i);
+        if (label[root] < 0) { label[root] = m_areaCount++; }
+        label[i] = label[root];
+    }
+
+    for (int y = 0; y < h; ++y)
+    {
+        for (int & area : m_areas.row(y))
+        {
+            if (area >= 0) { area = label[area]; }
+        }
+    }
+
+    // frontiers were recorded from the most open tile down, so the first one seen for a pair
+    // of areas is the saddle between them
+    std::map<std::pair<int, int>, size_t> chokeIndex;
+    for (auto & frontier : frontiers)
+    {
+        const int a = label[frontier.a];
+        const int b = label[frontier.b];
+        if (a == b) { continue; }
+
+        const auto key = std::make_pair(std::min(a, b), std::max(a, b));
+        if (chokeIndex.count(key)) { continue; }
+
+        Chokepoint choke;
+        choke.center = BWAPI::WalkPosition(frontier.index % w, frontier.index / w);
+        choke.width  = 2 * frontier.clearance * 8;
+        choke.areaA  = key.first;
+        choke.areaB  = key.second;
+
+        chokeIndex[key] = m_chokepoints.size();
+        m_chokepoints.push_back(choke);
+    }
+}
+
+// the chokepoint out of our main: the closest one by ground that borders the main's area
+void TerrainAnalyzer::findMainChoke(const MapTools & map)
+{
+    const BaseLocation * main = getStartingBase();
+    if (!main) { return; }
+
+    int bestDistance = std::numeric_limits<int>::max();
+    for (size_t i = 0; i < m_chokepoints.size(); ++i)
+    {
+        const Chokepoint & choke = m_chokepoints[i];
+        if (choke.areaA != main->area && choke.areaB != main->area) { continue; }
+
+        const BWAPI::Position chokePosition(choke.center);
+        int distance = map.getGroundDistance(main->depotCenter, chokePosition);
+        if (distance < 0) { distance = main->depotCenter.getApproxDistance(chokePosition); }
+
+        if (distance < bestDistance)
+        {
+            bestDistance = distance;
+            m_mainChoke = (int)i;
+        }
+    }
+}
+
+const std::vector<BaseLocation> & TerrainAnalyzer::getBaseLocations() const
+{
+    return m_bases;
+}
+
+const std::vector<Chokepoint> & TerrainAnalyzer::getChokepoints() const
+{
+    return m_chokepoints;
+}
+
+const BaseLocation * TerrainAnalyzer::getStartingBase() const
+{
+    return m_startBase >= 0 ? &m_bases[m_startBase] : nullptr;
+}
+
+const BaseLocation * TerrainAnalyzer::getClosestBase(const BWAPI::TilePosition & tile) const
+{
+    const BaseLocation * closest = nullptr;
+    for (auto & base : m_bases)
+    {
+        if (!closest || Distance(base.depotTile, tile) < Distance(closest->depotTile, tile))
+        {
+            closest = &base;
+        }
+    }
+
+    return closest;
+}
+
+const Chokepoint * TerrainAnalyzer::getMainChoke() const
+{
+    return m_mainChoke >= 0 ? &m_chokepoints[m_mainChoke] : nullptr;
+}
+
+int TerrainAnalyzer::getArea(const BWAPI::WalkPosition & walk) const
+{
+    if (walk.x < 0 || walk.y < 0 || walk.x >= (int)m_areas.width() || walk.y >= (int)m_areas.height()) { return -1; }
+
+    return m_areas.get(walk.x, walk.y);
+}
+
+// area of the walk tile in the middle of a build tile
+int TerrainAnalyzer::getArea(const BWAPI::TilePosition & tile) const
+{
+    return getArea(BWAPI::WalkPosition(tile.x * 4 + 2, tile.y * 4 + 2));
+}
+
+int TerrainAnalyzer::areaCount() const
+{
+    return m_areaCount;
+}
+
+double TerrainAnalyzer::elapsedMs() const
+{
+    return m_elapsedMs;
+}
+
+void TerrainAnalyzer::draw() const
+{
+    for (auto & base : m_bases)
+    {
+        const BWAPI::Position topLeft(base.depotTile);
+        const BWAPI::Color color = base.isStartLocation ? BWAPI::Colors::Yellow : BWAPI::Colors::Cyan;
+        BWAPI::Broodwar->drawBoxMap(topLeft, topLeft + BWAPI::Position(128, 96), color);
+
+        for (auto & mineral : base.minerals) { BWAPI::Broodwar->drawLineMap(base.depotCenter, mineral->getInitialPosition(), color); }
+        for (auto & geyser : base.geysers)   { BWAPI::Broodwar->drawLineMap(base.depotCenter, geyser->getInitialPosition(), BWAPI::Colors::Green); }
+    }
+
+    for (size_t i = 0; i < m_chokepoints.size(); ++i)
+    {
+        const Chokepoint & choke = m_chokepoints[i];
+        const BWAPI::Color color = (int)i == m_mainChoke ? BWAPI::Colors::Red : BWAPI::Colors::Orange;
+        BWAPI::Broodwar->drawCircleMap(BWAPI::Position(choke.center), choke.width / 2, color);
+        BWAPI::Broodwar->drawTextMap(BWAPI::Position(choke.center), "%d | %d", choke.areaA, choke.areaB);
+    }
+}
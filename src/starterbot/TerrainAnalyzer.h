@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Grid.hpp"
+
+#include <BWAPI.h>
+#include <vector>
+
+class MapTools;
+class ThreadPool;
+
+// A cluster of static minerals and geysers, and where a resource depot should go to mine it
+struct BaseLocation
+{
+    BWAPI::TilePosition         depotTile;              // top left tile of the depot
+    BWAPI::Position             depotCenter;
+    std::vector<BWAPI::Unit>    minerals;
+    std::vector<BWAPI::Unit>    geysers;
+    int                         area = -1;              // TerrainAnalyzer area the depot stands in
+    bool                        isStartLocation = false;
+};
+
+// The narrowest point of the passage between two areas
+struct Chokepoint
+{
+    BWAPI::WalkPosition         center;
+    int                         width = 0;              // pixels
+    int                         areaA = -1;
+    int                         areaB = -1;
+};
+
+// Terrain analysis in the spirit of BWEM: clusters static resources into base locations, finds
+// the best depot tile for each from the depot buildable layer, and splits the walk tiles into
+// areas separated by chokepoints using a watershed over the MapTools clearance layer.
+// The chokepoint pass and the depot search of every base run as separate ThreadPool tasks.
+class TerrainAnalyzer
+{
+    struct Resource
+    {
+        BWAPI::Unit         unit;
+        BWAPI::UnitType     type;
+        BWAPI::TilePosition tile;
+    };
+
+    struct Frontier
+    {
+        int a;
+        int b;
+        int index;
+        int clearance;
+    };
+
+    std::vector<BaseLocation>   m_bases;
+    std::vector<Chokepoint>     m_chokepoints;
+    Grid<int>                   m_areas;                // walk tile area id, -1 if unwalkable
+    int                         m_areaCount = 0;
+    int                         m_startBase = -1;
+    int                         m_mainChoke = -1;
+    double                      m_elapsedMs = 0;
+
+    void clusterResources(const std::vector<Resource> & resources, std::vector<std::vector<Resource>> & clusters) const;
+    void findDepot(const MapTools & map, const std::vector<Resource> & cluster, BaseLocation & base) const;
+    void computeAreas(const Grid<uint16_t> & clearance);
+    void findMainChoke(const MapTools & map);
+
+public:
+
+    TerrainAnalyzer();
+
+    // runs the whole analysis, blocking until every task handed to the pool has finished
+    void analyze(const MapTools & map, ThreadPool & pool);
+
+    const std::vector<BaseLocation> &   getBaseLocations() const;
+    const std::vector<Chokepoint> &     getChokepoints() const;
+    const BaseLocation *                getStartingBase() const;
+    const BaseLocation *                getClosestBase(const BWAPI::TilePosition & tile) const;
+    const Chokepoint *                  getMainChoke() const;
+    int                                 getArea(const BWAPI::WalkPosition & walk) const;
+    int                                 getArea(const BWAPI::TilePosition & tile) const;
+    int                                 areaCount() const;
+    double                              elapsedMs() const;
+    void                                draw() const;
+};
@@ -0,0 +1,86 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    if (threads == 0)
+    {
+        const size_t hardware = std::thread::hardware_concurrency();
+        threads = std::max<size_t>(1, hardware > 1 ? hardware - 1 : 1);
+    }
+
+    m_threads.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+    {
+        m_threads.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_taskReady.notify_all();
+    for (auto & thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_taskReady.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+
+            // finish whatever is still queued before shutting down
+            if (m_tasks.empty()) { return; }
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            ++m_busy;
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_busy;
+            if (m_busy == 0 && m_tasks.empty()) { m_allDone.notify_all(); }
+        }
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+
+    m_taskReady.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_allDone.wait(lock, [this] { return m_busy == 0 && m_tasks.empty(); });
+}
+
+bool ThreadPool::idle()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_busy == 0 && m_tasks.empty();
+}
+
+size_t ThreadPool::size() const
+{
+    return m_threads.size();
+}
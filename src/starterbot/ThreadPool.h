@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Fixed set of worker threads pulling tasks off a shared queue.
+// Tasks must not call into BWAPI: the client is not thread safe, so anything a task needs from
+// the game has to be copied out on the main thread before the task is submitted.
+class ThreadPool
+{
+    std::vector<std::thread>            m_threads;
+    std::deque<std::function<void()>>   m_tasks;
+    std::mutex                          m_mutex;
+    std::condition_variable             m_taskReady;    // signalled when a task is queued or on shutdown
+    std::condition_variable             m_allDone;      // signalled when the queue drains and nobody is busy
+    size_t                              m_busy = 0;
+    bool                                m_stop = false;
+
+    void workerLoop();
+
+public:
+
+    // 0 threads means one per hardware thread, minus the one the bot itself runs on
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    void operator=(const ThreadPool &) = delete;
+
+    void    submit(std::function<void()> task);
+
+    // blocks until every task submitted so far has finished
+    void    wait();
+
+    // true if there is nothing queued and nothing running
+    bool    idle();
+
+    size_t  size() const;
+};
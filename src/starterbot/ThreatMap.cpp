@@ -0,0 +1,216 @@
+#include "ThreatMap.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+namespace
+{
+    // damage of one shot of a weapon with the owner's current upgrades, including the
+    // weapon's own multiplier (two hits per attack for zealots, firebats, ...)
+    int WeaponDamage(BWAPI::Player player, BWAPI::WeaponType weapon)
+    {
+        const int upgrades = player->getUpgradeLevel(weapon.upgradeType());
+        return (weapon.damageAmount() + weapon.damageBonus() * upgrades) * weapon.damageFactor();
+    }
+}
+
+ThreatMap::ThreatMap()
+{
+
+}
+
+void ThreatMap::onStart()
+{
+    m_width  = BWAPI::Broodwar->mapWidth();
+    m_height = BWAPI::Broodwar->mapHeight();
+    m_ground = Grid<int>(m_width, m_height, 0);
+    m_air    = Grid<int>(m_width, m_height, 0);
+    m_stamps.clear();
+    m_stampsThisFrame = 0;
+}
+
+// The threat a unit adds around the tile it is standing on. Ranges are in tiles, measured from
+// the unit's center and widened by its own size since weapon range counts from its edge.
+// Bunkers and carriers have no weapon of their own, so they stand in for what they carry.
+ThreatMap::Stamp ThreatMap::makeStamp(BWAPI::Unit unit) const
+{
+    const BWAPI::UnitType type = unit->getType();
+    const BWAPI::Player player = unit->getPlayer();
+    const int extent = std::max({ type.dimensionLeft(), type.dimensionRight(), type.dimensionUp(), type.dimensionDown() });
+
+    Stamp stamp;
+    stamp.tile   = BWAPI::TilePosition(unit->getPosition());
+    stamp.type   = type;
+    stamp.active = true;
+
+    auto rangeInTiles = [extent](int pixels) { return (pixels + extent + 31) / 32; };
+
+    if (type == BWAPI::UnitTypes::Terran_Bunker)
+    {
+        const BWAPI::WeaponType rifle = BWAPI::WeaponTypes::Gauss_Rifle;
+        stamp.groundRange  = stamp.airRange  = rangeInTiles(player->weaponMaxRange(rifle) + 32);
+        stamp.groundDamage = stamp.airDamage = 4 * WeaponDamage(player, rifle);
+    }
+    else if (type == BWAPI::UnitTypes::Protoss_Carrier)
+    {
+        const BWAPI::WeaponType cannon = BWAPI::WeaponTypes::Pulse_Cannon;
+        stamp.groundRange  = stamp.airRange  = rangeInTiles(8 * 32);
+        stamp.groundDamage = stamp.airDamage = 8 * WeaponDamage(player, cannon);
+    }
+    else
+    {
+        if (type.groundWeapon() != BWAPI::WeaponTypes::None)
+        {
+            stamp.groundRange  = rangeInTiles(player->weaponMaxRange(type.groundWeapon()));
+            stamp.groundDamage = WeaponDamage(player, type.groundWeapon());
+        }
+
+        if (type.airWeapon() != BWAPI::WeaponTypes::None)
+        {
+            stamp.airRange  = rangeInTiles(player->weaponMaxRange(type.airWeapon()));
+            stamp.airDamage = WeaponDamage(player, type.airWeapon());
+        }
+    }
+
+    return stamp;
+}
+
+void ThreatMap::apply(const Stamp & stamp, int sign)
+{
+    if (stamp.groundDamage > 0) { applyDisc(m_ground, stamp.tile, stamp.groundRange, sign * stamp.groundDamage); }
+    if (stamp.airDamage > 0)    { applyDisc(m_air, stamp.tile, stamp.airRange, sign * stamp.airDamage); }
+}
+
+// adds value to every tile within range tiles of the center tile, clipped to the map
+void ThreatMap::applyDisc(Grid<int> & grid, const BWAPI::TilePosition & tile, int range, int value)
+{
+    const int y0 = std::max(0, tile.y - range);
+    const int y1 = std::min(m_height - 1, tile.y + range);
+
+    for (int y = y0; y <= y1; ++y)
+    {
+        const int dy = y - tile.y;
+        int dx = range;
+        while (dx * dx + dy * dy > range * range) { --dx; }
+
+        const int x0 = std::max(0, tile.x - dx);
+        const int x1 = std::min(m_width - 1, tile.x + dx);
+
+        const auto row = grid.row(y);
+        for (int x = x0; x <= x1; ++x)
+        {
+            row[x] += value;
+        }
+    }
+}
+
+// Walks the visible enemy units and re-stamps only those that changed tile or type since they
+// were last stamped. Unfinished buildings don't shoot yet, so they're stamped once completed.
+// Upgrades finishing mid-fight only show up once a unit moves, which is close enough.
+void ThreatMap::onFrame()
+{
+    PROFILE_SCOPE("ThreatMap::onFrame");
+
+    m_stampsThisFrame = 0;
+
+    for (auto & player : BWAPI::Broodwar->enemies())
+    {
+        for (auto & unit : player->getUnits())
+        {
+            if (!unit->isCompleted() || !unit->getPosition().isValid()) { continue; }
+
+            const size_t id = (size_t)unit->getID();
+            if (id >= m_stamps.size()) { m_stamps.resize(id + 1); }
+
+            Stamp & stamp = m_stamps[id];
+            if (stamp.active && stamp.type == unit->getType() && stamp.tile == BWAPI::TilePosition(unit->getPosition()))
+            {
+                continue;
+            }
+
+            if (stamp.active) { apply(stamp, -1); }
+            stamp = makeStamp(unit);
+            apply(stamp, 1);
+            ++m_stampsThisFrame;
+        }
+    }
+
+    PROFILE_COUNT("threat stamps", m_stampsThisFrame);
+
+    if (m_drawThreat)
+    {
+        draw();
+    }
+}
+
+void ThreatMap::onUnitDestroy(BWAPI::Unit unit)
+{
+    const size_t id = (size_t)unit->getID();
+    if (id >= m_stamps.size() || !m_stamps[id].active) { return; }
+
+    apply(m_stamps[id], -1);
+    m_stamps[id] = Stamp();
+}
+
+void ThreatMap::toggleDraw()
+{
+    m_drawThreat = !m_drawThreat;
+}
+
+void ThreatMap::draw() const
+{
+    const BWAPI::TilePosition screen(BWAPI::Broodwar->getScreenPosition());
+
+    for (int y = std::max(0, screen.y); y < std::min(m_height, screen.y + 15); ++y)
+    {
+        for (int x = std::max(0, screen.x); x < std::min(m_width, screen.x + 20); ++x)
+        {
+            const int ground = m_ground.get(x, y);
+            const int air    = m_air.get(x, y);
+            if (ground == 0 && air == 0) { continue; }
+
+            if (ground > 0) { BWAPI::Broodwar->drawBoxMap(x * 32 + 2, y * 32 + 2, x * 32 + 30, y * 32 + 30, BWAPI::Colors::Red); }
+            if (air > 0)    { BWAPI::Broodwar->drawBoxMap(x * 32 + 6, y * 32 + 6, x * 32 + 26, y * 32 + 26, BWAPI::Colors::Blue); }
+            BWAPI::Broodwar->drawTextMap(x * 32 + 8, y * 32 + 10, "%d/%d", ground, air);
+        }
+    }
+}
+
+int ThreatMap::getGroundThreat(int tileX, int tileY) const
+{
+    if (tileX < 0 || tileY < 0 || tileX >= m_width || tileY >= m_height) { return 0; }
+
+    return m_ground.get(tileX, tileY);
+}
+
+int ThreatMap::getGroundThreat(const BWAPI::TilePosition & tile) const
+{
+    return getGroundThreat(tile.x, tile.y);
+}
+
+int ThreatMap::getGroundThreat(const BWAPI::Position & pos) const
+{
+    return getGroundThreat(BWAPI::TilePosition(pos));
+}
+
+int ThreatMap::getAirThreat(int tileX, int tileY) const
+{
+    if (tileX < 0 || tileY < 0 || tileX >= m_width || tileY >= m_height) { return 0; }
+
+    return m_air.get(tileX, tileY);
+}
+
+int ThreatMap::getAirThreat(const BWAPI::TilePosition & tile) const
+{
+    return getAirThreat(tile.x, tile.y);
+}
+
+int ThreatMap::getAirThreat(const BWAPI::Position & pos) const
+{
+    return getAirThreat(BWAPI::TilePosition(pos));
+}
+
+int ThreatMap::stampsThisFrame() const
+{
+    return m_stampsThisFrame;
+}
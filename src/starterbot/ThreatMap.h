@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Grid.hpp"
+
+#include <BWAPI.h>
+#include <vector>
+
+// Ground and air threat per build tile: the sum of the weapon damage of every enemy unit that
+// can hit a unit standing on that tile. Each enemy's contribution is a disc stamped around the
+// tile it stands on. A unit only gets re-stamped when it changes tile or type, by subtracting
+// its old disc and adding the new one, so a frame only touches the tiles under the units that
+// moved, appeared or died. Units that go into the fog keep threatening where they were last seen.
+class ThreatMap
+{
+    struct Stamp
+    {
+        BWAPI::TilePosition tile = BWAPI::TilePositions::None;
+        BWAPI::UnitType     type = BWAPI::UnitTypes::None;
+        int                 groundRange = 0;    // tiles
+        int                 groundDamage = 0;
+        int                 airRange = 0;
+        int                 airDamage = 0;
+        bool                active = false;
+    };
+
+    Grid<int>           m_ground;
+    Grid<int>           m_air;
+    std::vector<Stamp>  m_stamps;               // indexed by unit id
+    int                 m_width = 0;
+    int                 m_height = 0;
+    int                 m_stampsThisFrame = 0;
+    bool                m_drawThreat = false;
+
+    Stamp   makeStamp(BWAPI::Unit unit) const;
+    void    apply(const Stamp & stamp, int sign);
+    void    applyDisc(Grid<int> & grid, const BWAPI::TilePosition & tile, int range, int value);
+
+public:
+
+    ThreatMap();
+
+    void    onStart();
+    void    onFrame();
+    void    onUnitDestroy(BWAPI::Unit unit);
+    void    draw() const;
+    void    toggleDraw();
+
+    int     getGroundThreat(int tileX, int tileY) const;
+    int     getGroundThreat(const BWAPI::TilePosition & tile) const;
+    int     getGroundThreat(const BWAPI::Position & pos) const;
+    int     getAirThreat(int tileX, int tileY) const;
+    int     getAirThreat(const BWAPI::TilePosition & tile) const;
+    int     getAirThreat(const BWAPI::Position & pos) const;
+
+    // how many units had their threat re-stamped on the last onFrame
+    int     stampsThisFrame() const;
+};
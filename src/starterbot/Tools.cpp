@@ -1,16 +1,37 @@
 #include "Tools.h"
+#include "MapTools.h"
+#include "DebugOverlay.h"
+#include "UnitIndex.h"
+#include "UnitCensus.h"
+#include "SupplyLedger.h"
 #include "string"
 
+namespace
+{
+    // only units that are in the given set
+    struct InSet
+    {
+        const BWAPI::Unitset& units;
+        bool operator () (const UnitIndex::Entry& e) const { return units.count(e.unit) > 0; }
+    };
+}
+
 
+// Closest unit of a set by edge distance, with a plain scan that computes each distance only
+// once. For all units of a type or player, query the UnitIndex with a filter instead
+// (getClosestMineralField), which only looks at the cells around p.
 BWAPI::Unit Tools::GetClosestUnitTo(BWAPI::Position p, const BWAPI::Unitset& units)
 {
     BWAPI::Unit closestUnit = nullptr;
+    int closestDistance = std::numeric_limits<int>::max();
 
     for (auto& u : units)
     {
-        if (!closestUnit || u->getDistance(p) < closestUnit->getDistance(p))
+        const int distance = u->getDistance(p);
+        if (!closestUnit || distance < closestDistance)
         {
             closestUnit = u;
+            closestDistance = distance;
         }
     }
 
@@ -18,23 +39,12 @@ BWAPI::Unit Tools::GetClosestUnitTo(BWAPI::Position p, const BWAPI::Unitset& uni
 }
 
 BWAPI::Unit Tools::getClosestMineralField(BWAPI::Position pos) {
-    BWAPI::Unit closestMineralField = nullptr;
-    double closestDistance = std::numeric_limits<double>::infinity();
-
-    // Obtener todos los campos de minerales
-    for (auto& mineralField : BWAPI::Broodwar->getMinerals()) {
-        // Calcular la distancia entre la posicin dada y el campo de mineral
-        double distance = pos.getDistance(mineralField->getPosition());
-
-        // Actualizar el campo de mineral ms cercano si es necesario
-        if (distance < closestDistance) {
-            closestMineralField = mineralField;
-            closestDistance = distance;
-        }
-    }
+    // Buscar en las celdas del UnitIndex cercanas a la posicin dada, en vez de todos los minerales del mapa
+    UnitFilter minerals;
+    minerals.typeTest = [](BWAPI::UnitType type) { return type.isMineralField(); };
 
     // Devolver el campo de mineral ms cercano
-    return closestMineralField;
+    return UnitIndex::getInstance()->getClosest(pos, minerals);
 }
 
 BWAPI::Unit Tools::GetClosestUnitTo(BWAPI::Unit unit, const BWAPI::Unitset& units)
@@ -43,6 +53,16 @@ BWAPI::Unit Tools::GetClosestUnitTo(BWAPI::Unit unit, const BWAPI::Unitset& unit
     return GetClosestUnitTo(unit->getPosition(), units);
 }
 
+int Tools::CountUnitsOfType(BWAPI::UnitType type)
+{
+    return UnitCensus::getInstance()->total(type);
+}
+
+int Tools::CountCompletedUnitsOfType(BWAPI::UnitType type)
+{
+    return UnitCensus::getInstance()->completed(type);
+}
+
 int Tools::CountUnitsOfType(BWAPI::UnitType type, const BWAPI::Unitset& units)
 {
     int sum = 0;
@@ -75,29 +95,17 @@ int Tools::CountCompletedUnitsOfType(BWAPI::UnitType type, const BWAPI::Unitset&
 
 BWAPI::Unit Tools::GetUnitOfType(BWAPI::UnitType type)
 {
-    // For each unit that we own
-    for (auto& unit : BWAPI::Broodwar->self()->getUnits())
-    {
-        // if the unit is of the correct type, and it actually has been constructed, return it
-        if (unit->getType() == type && unit->isCompleted())
-        {
-            return unit;
-        }
-    }
+    // The census keeps the completed units of each type, so the first one is the one the old
+    // scan over our units would have returned
+    const std::vector<BWAPI::Unit>& units = UnitCensus::getInstance()->completedUnits(type);
 
     // If we didn't find a valid unit to return, make sure we return nullptr
-    return nullptr;
+    return units.empty() ? nullptr : units.front();
 }
 
 // get all workers of player
-BWAPI::Unitset Tools::getWorkers() {
-    BWAPI::Unitset workers;
-    for (auto& u : BWAPI::Broodwar->self()->getUnits()) {
-        if (u->getType().isWorker()) {
-            workers.insert(u);
-        }
-    }
-    return workers;
+const BWAPI::Unitset& Tools::getWorkers() {
+    return UnitCensus::getInstance()->workers();
 }
 
 BWAPI::Unit Tools::GetDepot()
@@ -108,61 +116,35 @@ BWAPI::Unit Tools::GetDepot()
 
 // Get units on screen filter on the Unitset
 BWAPI::Unitset Tools::getUnitsOnScreen(BWAPI::Unitset& units) {
-    BWAPI::Unitset unitsOnScreen;
-
     BWAPI::Position screenTopLeft = BWAPI::Broodwar->getScreenPosition();
     BWAPI::Position screenBottomRight = screenTopLeft + BWAPI::Position(
         Tools::SCREEN_WIDTH, Tools::SCREEN_HEIGHT);
 
-    for (auto& unit : units) {
-        BWAPI::Position unitPos = unit->getPosition();
-        BWAPI::UnitType type = unit->getType();
-
-        // Calcular los lmites de la unidad
-        int left = unitPos.x - type.dimensionLeft();
-        int right = unitPos.x + type.dimensionRight();
-        int top = unitPos.y - type.dimensionUp();
-        int bottom = unitPos.y + type.dimensionDown();
-
-        // Verificar si la unidad est en la pantalla
-        if (right >= screenTopLeft.x && left <= screenBottomRight.x &&
-            bottom >= screenTopLeft.y && top <= screenBottomRight.y) {
-            unitsOnScreen.insert(unit);
-        }
-    }
+    // Solo se revisan las unidades de las celdas que tocan la pantalla
+    std::vector<BWAPI::Unit> found;
+    UnitIndex::getInstance()->getInRectangle(screenTopLeft.x, screenTopLeft.y, screenBottomRight.x, screenBottomRight.y, InSet{ units }, found);
 
+    BWAPI::Unitset unitsOnScreen;
+    for (auto& unit : found) { unitsOnScreen.insert(unit); }
     return unitsOnScreen;
 }
 // Get all units on screen
 BWAPI::Unitset Tools::getUnitsOnScreen() {
-    BWAPI::Unitset unitsOnScreen;
-
     BWAPI::Position screenTopLeft = BWAPI::Broodwar->getScreenPosition();
     BWAPI::Position screenBottomRight = screenTopLeft + BWAPI::Position(
         Tools::SCREEN_WIDTH, Tools::SCREEN_HEIGHT);
 
-    for (auto& unit : BWAPI::Broodwar->getAllUnits()) {
-        BWAPI::Position unitPos = unit->getPosition();
-        BWAPI::UnitType type = unit->getType();
-
-        // Calcular los lmites de la unidad
-        int left = unitPos.x - type.dimensionLeft();
-        int right = unitPos.x + type.dimensionRight();
-        int top = unitPos.y - type.dimensionUp();
-        int bottom = unitPos.y + type.dimensionDown();
-
-        // Verificar si la unidad est en la pantalla
-        if (right >= screenTopLeft.x && left <= screenBottomRight.x &&
-            bottom >= screenTopLeft.y && top <= screenBottomRight.y) {
-            unitsOnScreen.insert(unit);
-        }
-    }
+    // Solo se revisan las unidades de las celdas que tocan la pantalla
+    std::vector<BWAPI::Unit> found;
+    UnitIndex::getInstance()->getInRectangle(screenTopLeft.x, screenTopLeft.y, screenBottomRight.x, screenBottomRight.y, UnitFilter(), found);
 
+    BWAPI::Unitset unitsOnScreen;
+    for (auto& unit : found) { unitsOnScreen.insert(unit); }
     return unitsOnScreen;
 }
 
 // Attempt tp construct a building of a given type 
-bool Tools::BuildBuilding(BWAPI::UnitType type)
+bool Tools::BuildBuilding(MapTools& map, BWAPI::UnitType type)
 {
     // Get the type of unit that is required to build the desired building
     BWAPI::UnitType builderType = type.whatBuilds().first;
@@ -175,38 +157,50 @@ bool Tools::BuildBuilding(BWAPI::UnitType type)
     // Get a location that we want to build the building next to
     BWAPI::TilePosition desiredPos = BWAPI::Broodwar->self()->getStartLocation();
 
-    // Ask BWAPI for a building location near the desired position for the type
+    // Ask the MapTools placement index for the closest free spot, each candidate is an O(1) check
     int maxBuildRange = 64;
-    bool buildingOnCreep = type.requiresCreep();
-    BWAPI::TilePosition buildPos = BWAPI::Broodwar->getBuildLocation(type, desiredPos, maxBuildRange, buildingOnCreep);
-    return builder->build(type, buildPos);
+    BWAPI::TilePosition buildPos = map.getBuildLocation(type, desiredPos, maxBuildRange);
+    if (!buildPos.isValid() || !builder->build(type, buildPos)) { return false; }
+
+    // keep the spot from being handed out again while the worker walks there
+    map.reserveBuildLocation(type, buildPos);
+
+    // the supply of an ordered supply provider counts from now on
+    SupplyLedger::getInstance()->onBuildCommand(builder, type);
+    return true;
 }
 
 void Tools::DrawUnitCommands()
 {
+    DebugOverlay* overlay = DebugOverlay::getInstance();
+    if (!overlay->enabled(DebugOverlay::Channel::Commands)) { return; }
+
     for (auto& unit : BWAPI::Broodwar->self()->getUnits())
     {
         const BWAPI::UnitCommand & command = unit->getLastCommand();
+        const BWAPI::Position & pos = unit->getPosition();
 
         // If the previous command had a ground position target, draw it in red
         // Example: move to location on the map
         if (command.getTargetPosition() != BWAPI::Positions::None)
         {
-            BWAPI::Broodwar->drawLineMap(unit->getPosition(), command.getTargetPosition(), BWAPI::Colors::Red);
+            overlay->line(pos.x, pos.y, command.getTargetPosition().x, command.getTargetPosition().y, BWAPI::Colors::Red);
         }
 
         // If the previous command had a tile position target, draw it in red
         // Example: build at given tile position location
         if (command.getTargetTilePosition() != BWAPI::TilePositions::None)
         {
-            BWAPI::Broodwar->drawLineMap(unit->getPosition(), BWAPI::Position(command.getTargetTilePosition()), BWAPI::Colors::Green);
+            const BWAPI::Position target(command.getTargetTilePosition());
+            overlay->line(pos.x, pos.y, target.x, target.y, BWAPI::Colors::Green);
         }
 
         // If the previous command had a unit target, draw it in red
         // Example: attack unit, mine mineral, etc
         if (command.getTarget() != nullptr)
         {
-            BWAPI::Broodwar->drawLineMap(unit->getPosition(), command.getTarget()->getPosition(), BWAPI::Colors::White);
+            const BWAPI::Position & target = command.getTarget()->getPosition();
+            overlay->line(pos.x, pos.y, target.x, target.y, BWAPI::Colors::White);
         }
     }
 }
@@ -214,11 +208,12 @@ void Tools::DrawUnitCommands()
 
 void Tools::DrawUnitBoundingBoxes()
 {
+    DebugOverlay* overlay = DebugOverlay::getInstance();
+    if (!overlay->enabled(DebugOverlay::Channel::BoundingBoxes)) { return; }
+
     for (auto& unit : BWAPI::Broodwar->getAllUnits())
     {
-        BWAPI::Position topLeft(unit->getLeft(), unit->getTop());
-        BWAPI::Position bottomRight(unit->getRight(), unit->getBottom());
-        BWAPI::Broodwar->drawBoxMap(topLeft, bottomRight, BWAPI::Colors::White);
+        overlay->box(unit->getLeft(), unit->getTop(), unit->getRight(), unit->getBottom(), BWAPI::Colors::White);
     }
 }
 
@@ -263,36 +258,9 @@ void Tools::SmartRightClick(BWAPI::Unit unit, BWAPI::Unit target)
 
 int Tools::GetTotalSupply(bool inProgress)
 {
-    // start the calculation by looking at our current completed supplyt
-    int totalSupply = BWAPI::Broodwar->self()->supplyTotal();
-
-    // if we don't want to calculate the supply in progress, just return that value
-    if (!inProgress) { return totalSupply; }
-
-    // if we do care about supply in progress, check all the currently constructing units if they will add supply
-    for (auto& unit : BWAPI::Broodwar->self()->getUnits())
-    {
-        // ignore units that are fully completed
-        if (unit->isCompleted()) { continue; }
-
-        // if they are not completed, then add their supply provided to the total supply
-        totalSupply += unit->getType().supplyProvided();
-    }
-
-    // one last tricky case: if a unit is currently on its way to build a supply provider, add it
-    for (auto& unit : BWAPI::Broodwar->self()->getUnits())
-    {
-        // get the last command given to the unit
-        const BWAPI::UnitCommand& command = unit->getLastCommand();
-
-        // if it's not a build command we can ignore it
-        if (command.getType() != BWAPI::UnitCommandTypes::Build) { continue; }
-
-        // add the supply amount of the unit that it's trying to build
-        totalSupply += command.getUnitType().supplyProvided();
-    }
-
-    return totalSupply;
+    // The SupplyLedger follows the supply under construction and the supply providers workers
+    // are on their way to build from unit events, so there is nothing to scan here
+    return SupplyLedger::getInstance()->total(inProgress);
 }
 
 void Tools::DrawUnitHealthBars()
@@ -300,7 +268,10 @@ void Tools::DrawUnitHealthBars()
     // how far up from the unit to draw the health bar
     int verticalOffset = -10;
 
-    // draw a health bar for each unit on the map
+    DebugOverlay* overlay = DebugOverlay::getInstance();
+    if (!overlay->enabled(DebugOverlay::Channel::HealthBars)) { return; }
+
+    // draw a health bar for each unit on screen
     for (auto& unit : BWAPI::Broodwar->getAllUnits())
     {
         // determine the position and dimensions of the unit
@@ -310,6 +281,9 @@ void Tools::DrawUnitHealthBars()
         int top = pos.y - unit->getType().dimensionUp();
         int bottom = pos.y + unit->getType().dimensionDown();
 
+        // bars sit above the unit, skip the unit if neither it nor its bars are in view
+        if (!overlay->onScreen(left, top + verticalOffset - 3, right, bottom)) { continue; }
+
         // if it's a resource, draw the resources remaining
         if (unit->getType().isResourceContainer() && unit->getInitialResources() > 0)
         {
@@ -349,14 +323,22 @@ void Tools::DrawHealthBar(BWAPI::Unit unit, double ratio, BWAPI::Color color, in
     int hpTop = top + yOffset + verticalOffset;
     int hpBottom = top + 4 + yOffset + verticalOffset;
 
-    BWAPI::Broodwar->drawBoxMap(BWAPI::Position(left, hpTop), BWAPI::Position(right, hpBottom), BWAPI::Colors::Grey, true);
-    BWAPI::Broodwar->drawBoxMap(BWAPI::Position(left, hpTop), BWAPI::Position(ratioRight, hpBottom), color, true);
-    BWAPI::Broodwar->drawBoxMap(BWAPI::Position(left, hpTop), BWAPI::Position(right, hpBottom), BWAPI::Colors::Black, false);
+    // the fill carries the information, the outline and the tics are the first to go when the
+    // overlay is short on shapes
+    DebugOverlay* overlay = DebugOverlay::getInstance();
+    const int detail = overlay->detailLevel();
+
+    overlay->box(left, hpTop, right, hpBottom, BWAPI::Colors::Grey, true);
+    overlay->box(left, hpTop, ratioRight, hpBottom, color, true);
+
+    if (detail >= 2) { return; }
+    overlay->box(left, hpTop, right, hpBottom, BWAPI::Colors::Black, false);
 
+    if (detail >= 1) { return; }
     int ticWidth = 3;
 
     for (int i(left); i < right - 1; i += ticWidth)
     {
-        BWAPI::Broodwar->drawLineMap(BWAPI::Position(i, hpTop), BWAPI::Position(i, hpBottom), BWAPI::Colors::Black);
+        overlay->line(i, hpTop, i, hpBottom, BWAPI::Colors::Black);
     }
 }
\ No newline at end of file
@@ -1,7 +1,12 @@
 #pragma once
 
 #include <BWAPI.h>
-#include <set>
+#include <array>
+#include <cstdint>
+#include <iterator>
+
+class MapTools;
+
 // AQUI puse lo que no necesita informacion exacta del bot
 namespace Tools
 {
@@ -14,32 +19,104 @@ namespace Tools
     int CountUnitsOfType(BWAPI::UnitType type, const BWAPI::Unitset& units);
     
     int CountCompletedUnitsOfType(BWAPI::UnitType type, const BWAPI::Unitset& units);
+
+    // Variantes para nuestras propias unidades, leen el censo de UnitCensus del frame actual
+    int CountUnitsOfType(BWAPI::UnitType type);
+    int CountCompletedUnitsOfType(BWAPI::UnitType type);
     
+    // Conjunto de tipos de unidad como mascara de bits sobre UnitTypes::Enum. Se puede armar en
+    // tiempo de compilacion y preguntar si un tipo esta en el conjunto es leer un bit.
+    struct UnitTypeMask
+    {
+        static constexpr int Words = (BWAPI::UnitTypes::Enum::MAX + 63) / 64;
+
+        std::array<uint64_t, Words> bits{};
+
+        constexpr UnitTypeMask() = default;
+
+        constexpr UnitTypeMask(std::initializer_list<BWAPI::UnitTypes::Enum::Enum> types)
+        {
+            for (auto type : types) { bits[type / 64] |= uint64_t(1) << (type % 64); }
+        }
+
+        constexpr bool contains(int id) const
+        {
+            return id >= 0 && id < BWAPI::UnitTypes::Enum::MAX && ((bits[id / 64] >> (id % 64)) & 1);
+        }
+
+        bool contains(BWAPI::UnitType type) const { return contains(type.getID()); }
+    };
+
+    template <BWAPI::UnitTypes::Enum::Enum... Types>
+    inline constexpr UnitTypeMask TypeMask = UnitTypeMask{ Types... };
+
+    // Recorre las unidades de un Unitset que son de los tipos de la mascara, sin copiarlas a otro
+    // Unitset: for (auto& u : Tools::eachUnitOfTypes<...>()) { ... }
+    class UnitsOfTypes
+    {
+        using SetIterator = BWAPI::Unitset::const_iterator;
+
+        const BWAPI::Unitset&   m_units;
+        UnitTypeMask            m_mask;
+
+    public:
+
+        class iterator
+        {
+            SetIterator         m_it;
+            SetIterator         m_end;
+            const UnitTypeMask* m_mask;
+
+            // avanza hasta la siguiente unidad de un tipo de la mascara
+            void skip() { while (m_it != m_end && !m_mask->contains((*m_it)->getType())) { ++m_it; } }
+
+        public:
+
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = BWAPI::Unit;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const BWAPI::Unit*;
+            using reference         = const BWAPI::Unit&;
+
+            iterator(SetIterator it, SetIterator end, const UnitTypeMask* mask) : m_it(it), m_end(end), m_mask(mask) { skip(); }
+
+            reference operator * () const { return *m_it; }
+            iterator& operator ++ () { ++m_it; skip(); return *this; }
+            iterator operator ++ (int) { iterator old = *this; ++(*this); return old; }
+            bool operator == (const iterator& other) const { return m_it == other.m_it; }
+            bool operator != (const iterator& other) const { return m_it != other.m_it; }
+        };
+
+        UnitsOfTypes(const BWAPI::Unitset& units, const UnitTypeMask& mask) : m_units(units), m_mask(mask) {}
+
+        iterator begin() const { return iterator(m_units.begin(), m_units.end(), &m_mask); }
+        iterator end() const { return iterator(m_units.end(), m_units.end(), &m_mask); }
+    };
+
+    // Las unidades de un Unitset (por defecto todas las del juego) de los tipos que le pases
+    template <BWAPI::UnitTypes::Enum::Enum... Types>
+    UnitsOfTypes eachUnitOfTypes(const BWAPI::Unitset& units = BWAPI::Broodwar->getAllUnits()) {
+        return UnitsOfTypes(units, TypeMask<Types...>);
+    }
+
     // Retorna un unitset de una cantidad indeterminada de tipos que le pases
-    template <class... Types>
-    BWAPI::Unitset getUnitsOfTypes(Types... types) {
+    template <BWAPI::UnitTypes::Enum::Enum... Types>
+    BWAPI::Unitset getUnitsOfTypes() {
         
         BWAPI::Unitset unitOfTypes;
-        std::set<BWAPI::UnitType> typesSet = { types... };
-        // for que recorre todas las unidades del juego con "u"
-        for (auto& u : BWAPI::Broodwar->getAllUnits()) {
-            // si el tipo esta en tipesets entonces lo agregas
-            //set.find si lo encuentra retorna un iterador y si no retorna un .end()
-            // equivalente al if variable in lista:
-            if (typesSet.find(u->getType()) != typesSet.end()) {
-                unitOfTypes.insert(u);
-            }
-        
+        for (auto& u : eachUnitOfTypes<Types...>()) {
+            unitOfTypes.insert(u);
         }
         return unitOfTypes;
     }
 
-    BWAPI::Unitset getWorkers();
+    const BWAPI::Unitset& getWorkers();
     BWAPI::Unit GetUnitOfType(BWAPI::UnitType type);
     BWAPI::Unit GetDepot();
 
 
-    bool BuildBuilding(BWAPI::UnitType type);
+    // Busca el lugar con el indice de construccion de MapTools y lo reserva si la orden se dio
+    bool BuildBuilding(MapTools& map, BWAPI::UnitType type);
 
     void DrawUnitBoundingBoxes();
     void DrawUnitCommands();
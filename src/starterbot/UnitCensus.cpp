@@ -0,0 +1,95 @@
+#include "UnitCensus.h"
+#include "Profiler.h"
+
+UnitCensus* UnitCensus::instance = nullptr;
+
+namespace
+{
+    const std::vector<BWAPI::Unit> NoUnits;
+}
+
+UnitCensus* UnitCensus::getInstance()
+{
+    if (instance == nullptr) {
+        instance = new UnitCensus();
+    }
+    return instance;
+}
+
+void UnitCensus::update()
+{
+    PROFILE_SCOPE("UnitCensus::update");
+
+    m_completed.fill(0);
+    m_inProgress.fill(0);
+    m_idle.fill(0);
+    for (auto & units : m_completedUnits) { units.clear(); }
+    for (auto & units : m_idleUnits) { units.clear(); }
+    m_workers.clear();
+    m_lastFrame = BWAPI::Broodwar->getFrameCount();
+
+    for (auto & unit : BWAPI::Broodwar->self()->getUnits())
+    {
+        const BWAPI::UnitType type = unit->getType();
+        if (!valid(type)) { continue; }
+
+        const int t = index(type);
+
+        if (type.isWorker()) { m_workers.insert(unit); }
+
+        if (!unit->isCompleted())
+        {
+            ++m_inProgress[t];
+            continue;
+        }
+
+        ++m_completed[t];
+        m_completedUnits[t].push_back(unit);
+
+        if (unit->isIdle())
+        {
+            ++m_idle[t];
+            m_idleUnits[t].push_back(unit);
+        }
+    }
+}
+
+int UnitCensus::completed(BWAPI::UnitType type) const
+{
+    return valid(type) ? m_completed[index(type)] : 0;
+}
+
+int UnitCensus::inProgress(BWAPI::UnitType type) const
+{
+    return valid(type) ? m_inProgress[index(type)] : 0;
+}
+
+int UnitCensus::total(BWAPI::UnitType type) const
+{
+    return valid(type) ? m_completed[index(type)] + m_inProgress[index(type)] : 0;
+}
+
+int UnitCensus::idle(BWAPI::UnitType type) const
+{
+    return valid(type) ? m_idle[index(type)] : 0;
+}
+
+const std::vector<BWAPI::Unit> & UnitCensus::completedUnits(BWAPI::UnitType type) const
+{
+    return valid(type) ? m_completedUnits[index(type)] : NoUnits;
+}
+
+const std::vector<BWAPI::Unit> & UnitCensus::idleUnits(BWAPI::UnitType type) const
+{
+    return valid(type) ? m_idleUnits[index(type)] : NoUnits;
+}
+
+const BWAPI::Unitset & UnitCensus::workers() const
+{
+    return m_workers;
+}
+
+int UnitCensus::lastFrame() const
+{
+    return m_lastFrame;
+}
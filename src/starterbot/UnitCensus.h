@@ -0,0 +1,56 @@
+#pragma once
+
+#include <BWAPI.h>
+#include <array>
+#include <vector>
+
+// Counts and lists of our own units by type, taken in one pass over self()->getUnits() at the
+// start of every frame. Everything is stored in arrays indexed by UnitTypes::Enum, so the
+// questions the bot asks every frame (how many marines, which barracks are idle, where is the
+// depot) are answered without walking the unit set again.
+class UnitCensus
+{
+public:
+
+    static const int TypeCount = BWAPI::UnitTypes::Enum::MAX;
+
+private:
+
+    static UnitCensus* instance;
+
+    std::array<int, TypeCount>                      m_completed{};
+    std::array<int, TypeCount>                      m_inProgress{};
+    std::array<int, TypeCount>                      m_idle{};
+    std::array<std::vector<BWAPI::Unit>, TypeCount> m_completedUnits;   // completed units, in unit set order
+    std::array<std::vector<BWAPI::Unit>, TypeCount> m_idleUnits;        // completed and idle
+    BWAPI::Unitset                                  m_workers;
+    int                                             m_lastFrame = -1;
+
+    UnitCensus() {}
+
+    static inline int index(BWAPI::UnitType type) { return type.getID(); }
+    static inline bool valid(BWAPI::UnitType type) { return type.getID() >= 0 && type.getID() < TypeCount; }
+
+public:
+
+    UnitCensus(UnitCensus& other) = delete;
+    void operator=(const UnitCensus&) = delete;
+
+    static UnitCensus* getInstance();
+
+    // takes the census; called at the start of every frame and once in onStart
+    void    update();
+
+    int     completed(BWAPI::UnitType type) const;
+    int     inProgress(BWAPI::UnitType type) const;
+    int     total(BWAPI::UnitType type) const;
+    int     idle(BWAPI::UnitType type) const;
+
+    const std::vector<BWAPI::Unit> & completedUnits(BWAPI::UnitType type) const;
+    const std::vector<BWAPI::Unit> & idleUnits(BWAPI::UnitType type) const;
+
+    // all of our workers, finished or not
+    const BWAPI::Unitset & workers() const;
+
+    int     lastFrame() const;
+};
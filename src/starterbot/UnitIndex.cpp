@@ -0,0 +1,65 @@
+#include "UnitIndex.h"
+#include "Profiler.h"
+
+UnitIndex* UnitIndex::instance = nullptr;
+
+UnitIndex* UnitIndex::getInstance()
+{
+    if (instance == nullptr) {
+        instance = new UnitIndex();
+    }
+    return instance;
+}
+
+void UnitIndex::onStart()
+{
+    m_cols = (BWAPI::Broodwar->mapWidth() * 32 + CellSize - 1) / CellSize;
+    m_rows = (BWAPI::Broodwar->mapHeight() * 32 + CellSize - 1) / CellSize;
+    m_cellStart.assign((size_t)m_cols * m_rows + 1, 0);
+    m_entries.clear();
+
+    rebuild();
+}
+
+// Counting sort of all units by cell: one pass to read every unit and count the cells, a prefix
+// sum for where each cell starts, and one pass to drop the entries into place
+void UnitIndex::rebuild()
+{
+    PROFILE_SCOPE("UnitIndex::rebuild");
+
+    m_scratch.clear();
+    m_scratchCells.clear();
+    m_maxExtent = 0;
+    std::fill(m_cellStart.begin(), m_cellStart.end(), 0);
+
+    for (auto & unit : BWAPI::Broodwar->getAllUnits())
+    {
+        // units inside bunkers, transports and refineries have no position
+        const BWAPI::Position position = unit->getPosition();
+        if (!position.isValid()) { continue; }
+
+        const BWAPI::UnitType type = unit->getType();
+        const Entry entry = { unit, type, unit->getPlayer(), position,
+                              position.x - type.dimensionLeft(), position.y - type.dimensionUp(),
+                              position.x + type.dimensionRight(), position.y + type.dimensionDown() };
+
+        m_maxExtent = std::max({ m_maxExtent, type.dimensionLeft(), type.dimensionRight(), type.dimensionUp(), type.dimensionDown() });
+
+        const int cell = cellY(position.y) * m_cols + cellX(position.x);
+        m_scratch.push_back(entry);
+        m_scratchCells.push_back(cell);
+        ++m_cellStart[cell + 1];
+    }
+
+    for (size_t c = 1; c < m_cellStart.size(); ++c) { m_cellStart[c] += m_cellStart[c - 1]; }
+
+    // place entries using a running cursor per cell, then restore the starts the cursors consumed
+    m_entries.resize(m_scratch.size());
+    for (size_t i = 0; i < m_scratch.size(); ++i)
+    {
+        m_entries[m_cellStart[m_scratchCells[i]]++] = m_scratch[i];
+    }
+
+    for (size_t c = m_cellStart.size() - 1; c > 0; --c) { m_cellStart[c] = m_cellStart[c - 1]; }
+    m_cellStart[0] = 0;
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <BWAPI.h>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+// Uniform grid over the map holding every accessible unit, rebuilt once per frame from
+// getAllUnits. Units are bucketed by the cell their center falls in and stored cell by cell in
+// one array, so a query only looks at the cells near it and its cost depends on how many units
+// are around, not on how many are on the map. Distances are between unit centers.
+//
+// Queries take a predicate on an Entry; UnitFilter covers the usual type and player filters.
+class UnitIndex
+{
+public:
+
+    struct Entry
+    {
+        BWAPI::Unit     unit;
+        BWAPI::UnitType type;
+        BWAPI::Player   player;
+        BWAPI::Position position;
+        int             left, top, right, bottom;
+    };
+
+    static const int CellSize = 128;
+
+private:
+
+    static UnitIndex* instance;
+
+    std::vector<Entry>  m_entries;          // sorted by cell
+    std::vector<int>    m_cellStart;        // entries of cell c are [m_cellStart[c], m_cellStart[c+1])
+    std::vector<Entry>  m_scratch;
+    std::vector<int>    m_scratchCells;
+    int                 m_cols = 0;
+    int                 m_rows = 0;
+    int                 m_maxExtent = 0;    // largest distance from a unit's center to its edge
+
+    UnitIndex() {}
+
+    inline int cellX(int x) const { return std::clamp(x / CellSize, 0, m_cols - 1); }
+    inline int cellY(int y) const { return std::clamp(y / CellSize, 0, m_rows - 1); }
+
+    static inline long long DistanceSq(const BWAPI::Position & a, const BWAPI::Position & b)
+    {
+        const long long dx = a.x - b.x;
+        const long long dy = a.y - b.y;
+        return dx * dx + dy * dy;
+    }
+
+    // calls f on every entry in the cells at chessboard distance r from (cx, cy)
+    template <class F>
+    void forEachInRing(int cx, int cy, int r, F && f) const
+    {
+        for (int y = cy - r; y <= cy + r; ++y)
+        {
+            if (y < 0 || y >= m_rows) { continue; }
+
+            const int step = (y == cy - r || y == cy + r || r == 0) ? 1 : 2 * r;
+            for (int x = cx - r; x <= cx + r; x += step)
+            {
+                if (x < 0 || x >= m_cols) { continue; }
+
+                const int cell = y * m_cols + x;
+                for (int i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i) { f(m_entries[i]); }
+            }
+        }
+    }
+
+    // calls f on every entry in the cells overlapping a rectangle
+    template <class F>
+    void forEachInCells(int left, int top, int right, int bottom, F && f) const
+    {
+        if (m_cols == 0) { return; }
+
+        for (int y = cellY(top); y <= cellY(bottom); ++y)
+        {
+            for (int x = cellX(left); x <= cellX(right); ++x)
+            {
+                const int cell = y * m_cols + x;
+                for (int i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i) { f(m_entries[i]); }
+            }
+        }
+    }
+
+public:
+
+    UnitIndex(UnitIndex& other) = delete;
+    void operator=(const UnitIndex&) = delete;
+
+    static UnitIndex* getInstance();
+
+    void    onStart();
+    void    rebuild();
+
+    const std::vector<Entry> & entries() const { return m_entries; }
+
+    // closest unit to p within maxDistance pixels that satisfies pred, nullptr if none
+    template <class Pred>
+    BWAPI::Unit getClosest(const BWAPI::Position & p, Pred && pred, int maxDistance = std::numeric_limits<int>::max()) const
+    {
+        if (m_cols == 0) { return nullptr; }
+
+        const int cx = cellX(p.x);
+        const int cy = cellY(p.y);
+        const int maxRing = std::max(m_cols, m_rows);
+
+        BWAPI::Unit best = nullptr;
+        long long bestDistance = maxDistance == std::numeric_limits<int>::max()
+            ? std::numeric_limits<long long>::max() : (long long)maxDistance * maxDistance;
+
+        for (int r = 0; r <= maxRing; ++r)
+        {
+            // nothing in ring r can be closer than (r-1) cells
+            const long long ringDistance = (long long)std::max(0, r - 1) * CellSize;
+            if (ringDistance * ringDistance > bestDistance) { break; }
+
+            forEachInRing(cx, cy, r, [&](const Entry & e)
+            {
+                if (!pred(e)) { return; }
+
+                const long long d = DistanceSq(p, e.position);
+                if (d < bestDistance || (d == bestDistance && !best))
+                {
+                    bestDistance = d;
+                    best = e.unit;
+                }
+            });
+        }
+
+        return best;
+    }
+
+    // the k closest units to p that satisfy pred, closest first
+    template <class Pred>
+    void getKNearest(const BWAPI::Position & p, size_t k, Pred && pred, std::vector<BWAPI::Unit> & out) const
+    {
+        out.clear();
+        if (m_cols == 0 || k == 0) { return; }
+
+        const int cx = cellX(p.x);
+        const int cy = cellY(p.y);
+        const int maxRing = std::max(m_cols, m_rows);
+
+        // max-heap on distance holding the best k found so far
+        std::vector<std::pair<long long, BWAPI::Unit>> heap;
+        heap.reserve(k + 1);
+
+        for (int r = 0; r <= maxRing; ++r)
+        {
+            const long long ringDistance = (long long)std::max(0, r - 1) * CellSize;
+            if (heap.size() == k && ringDistance * ringDistance > heap.front().first) { break; }
+
+            forEachInRing(cx, cy, r, [&](const Entry & e)
+            {
+                if (!pred(e)) { return; }
+
+                const long long d = DistanceSq(p, e.position);
+                if (heap.size() == k && d >= heap.front().first) { return; }
+
+                heap.emplace_back(d, e.unit);
+                std::push_heap(heap.begin(), heap.end());
+                if (heap.size() > k)
+                {
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.pop_back();
+                }
+            });
+        }
+
+        std::sort_heap(heap.begin(), heap.end());
+        for (auto & [d, unit] : heap) { out.push_back(unit); }
+    }
+
+    // every unit whose center is within radius pixels of p and that satisfies pred
+    template <class Pred>
+    void getInRadius(const BWAPI::Position & p, int radius, Pred && pred, std::vector<BWAPI::Unit> & out) const
+    {
+        out.clear();
+        const long long radiusSq = (long long)radius * radius;
+
+        forEachInCells(p.x - radius, p.y - radius, p.x + radius, p.y + radius, [&](const Entry & e)
+        {
+            if (DistanceSq(p, e.position) <= radiusSq && pred(e)) { out.push_back(e.unit); }
+        });
+    }
+
+    // every unit whose bounding box overlaps the rectangle and that satisfies pred
+    template <class Pred>
+    void getInRectangle(int left, int top, int right, int bottom, Pred && pred, std::vector<BWAPI::Unit> & out) const
+    {
+        out.clear();
+
+        // a unit can overlap the rectangle from a cell outside it by up to its own extent
+        forEachInCells(left - m_maxExtent, top - m_maxExtent, right + m_maxExtent, bottom + m_maxExtent, [&](const Entry & e)
+        {
+            if (e.right >= left && e.left <= right && e.bottom >= top && e.top <= bottom && pred(e)) { out.push_back(e.unit); }
+        });
+    }
+};
+
+// The usual query filter: a unit type (or any), a player (or any), and optionally a test on the
+// type such as UnitType::isMineralField for all three kinds of mineral field
+struct UnitFilter
+{
+    BWAPI::UnitType type = BWAPI::UnitTypes::AllUnits;
+    BWAPI::Player   player = nullptr;
+    bool            (*typeTest)(BWAPI::UnitType) = nullptr;
+
+    inline bool operator () (const UnitIndex::Entry & e) const
+    {
+        return (type == BWAPI::UnitTypes::AllUnits || e.type == type)
+            && (!player || e.player == player)
+            && (!typeTest || typeTest(e.type));
+    }
+};
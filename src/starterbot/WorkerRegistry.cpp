@@ -0,0 +1,166 @@
+#include "WorkerRegistry.h"
+
+#include <algorithm>
+
+WorkerRegistry::WorkerRegistry()
+    : m_slotOfId(MaxUnitId, -1)
+{
+
+}
+
+void WorkerRegistry::clear()
+{
+    std::fill(m_slotOfId.begin(), m_slotOfId.end(), -1);
+    m_units.clear();
+    m_roles.clear();
+    m_rolePosition.clear();
+    m_resources.clear();
+    m_buildTypes.clear();
+    m_buildTargets.clear();
+    for (auto & workers : m_byRole) { workers.clear(); }
+}
+
+int WorkerRegistry::slot(BWAPI::Unit unit) const
+{
+    if (!unit) { return -1; }
+
+    const int id = unit->getID();
+    return (id >= 0 && id < MaxUnitId) ? m_slotOfId[id] : -1;
+}
+
+// takes the worker out of its role's list, moving the last worker of that list into its place
+void WorkerRegistry::unlinkRole(int slot)
+{
+    std::vector<BWAPI::Unit> & list = m_byRole[(size_t)m_roles[slot]];
+    const int position = m_rolePosition[slot];
+
+    list[position] = list.back();
+    m_rolePosition[m_slotOfId[list[position]->getID()]] = position;
+    list.pop_back();
+}
+
+void WorkerRegistry::linkRole(int slot, WorkerRole role)
+{
+    std::vector<BWAPI::Unit> & list = m_byRole[(size_t)role];
+
+    m_roles[slot] = role;
+    m_rolePosition[slot] = (int)list.size();
+    list.push_back(m_units[slot]);
+}
+
+bool WorkerRegistry::add(BWAPI::Unit worker, WorkerRole role)
+{
+    if (!worker) { return false; }
+
+    const int id = worker->getID();
+    if (id < 0 || id >= MaxUnitId || m_slotOfId[id] >= 0) { return false; }
+
+    const int s = (int)m_units.size();
+    m_slotOfId[id] = s;
+    m_units.push_back(worker);
+    m_roles.push_back(role);
+    m_rolePosition.push_back(0);
+    m_resources.push_back(nullptr);
+    m_buildTypes.push_back(BWAPI::UnitTypes::None);
+    m_buildTargets.push_back(BWAPI::TilePositions::None);
+    linkRole(s, role);
+    return true;
+}
+
+// Moves the last slot into the removed one so the arrays stay dense
+bool WorkerRegistry::remove(BWAPI::Unit worker)
+{
+    const int s = slot(worker);
+    if (s < 0) { return false; }
+
+    unlinkRole(s);
+
+    const int last = (int)m_units.size() - 1;
+    if (s != last)
+    {
+        m_units[s]        = m_units[last];
+        m_roles[s]        = m_roles[last];
+        m_rolePosition[s] = m_rolePosition[last];
+        m_resources[s]    = m_resources[last];
+        m_buildTypes[s]   = m_buildTypes[last];
+        m_buildTargets[s] = m_buildTargets[last];
+        m_slotOfId[m_units[s]->getID()] = s;
+    }
+
+    m_units.pop_back();
+    m_roles.pop_back();
+    m_rolePosition.pop_back();
+    m_resources.pop_back();
+    m_buildTypes.pop_back();
+    m_buildTargets.pop_back();
+    m_slotOfId[worker->getID()] = -1;
+    return true;
+}
+
+bool WorkerRegistry::contains(BWAPI::Unit worker) const
+{
+    return slot(worker) >= 0;
+}
+
+size_t WorkerRegistry::size() const
+{
+    return m_units.size();
+}
+
+void WorkerRegistry::setRole(BWAPI::Unit worker, WorkerRole role)
+{
+    const int s = slot(worker);
+    if (s < 0 || m_roles[s] == role) { return; }
+
+    unlinkRole(s);
+    linkRole(s, role);
+}
+
+void WorkerRegistry::setResource(BWAPI::Unit worker, BWAPI::Unit resource)
+{
+    const int s = slot(worker);
+    if (s >= 0) { m_resources[s] = resource; }
+}
+
+void WorkerRegistry::setBuildTarget(BWAPI::Unit worker, BWAPI::UnitType type, BWAPI::TilePosition tile)
+{
+    const int s = slot(worker);
+    if (s < 0) { return; }
+
+    m_buildTypes[s]   = type;
+    m_buildTargets[s] = tile;
+}
+
+WorkerRole WorkerRegistry::getRole(BWAPI::Unit worker) const
+{
+    const int s = slot(worker);
+    return s >= 0 ? m_roles[s] : WorkerRole::Idle;
+}
+
+BWAPI::Unit WorkerRegistry::getResource(BWAPI::Unit worker) const
+{
+    const int s = slot(worker);
+    return s >= 0 ? m_resources[s] : nullptr;
+}
+
+BWAPI::UnitType WorkerRegistry::getBuildType(BWAPI::Unit worker) const
+{
+    const int s = slot(worker);
+    return s >= 0 ? m_buildTypes[s] : BWAPI::UnitTypes::None;
+}
+
+BWAPI::TilePosition WorkerRegistry::getBuildTarget(BWAPI::Unit worker) const
+{
+    const int s = slot(worker);
+    return s >= 0 ? m_buildTargets[s] : BWAPI::TilePositions::None;
+}
+
+const std::vector<BWAPI::Unit> & WorkerRegistry::getWorkers() const
+{
+    return m_units;
+}
+
+const std::vector<BWAPI::Unit> & WorkerRegistry::getWorkers(WorkerRole role) const
+{
+    return m_byRole[(size_t)role];
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <BWAPI.h>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+enum class WorkerRole : uint8_t { Idle, Minerals, Gas, Build, Scout, Count };
+
+// Our workers and what each one is doing, keyed by unit id. Ids index a sparse table pointing at
+// dense slots, and the per-worker data is kept in parallel arrays over those slots, so adding,
+// removing and looking up a worker are O(1) and walking all workers touches contiguous memory.
+// Each role also keeps the list of its workers, so "all gas workers" is a lookup, not a filter.
+//
+// Removing swaps the last slot into the hole, so slots and the order of the lists change; hold
+// on to units, not slots.
+class WorkerRegistry
+{
+public:
+
+    // unit ids are indices into the client's unit array, which has this many entries
+    static const int MaxUnitId = 10000;
+
+private:
+
+    std::vector<int>                    m_slotOfId;     // -1 if the id is not a registered worker
+
+    // one entry per slot
+    std::vector<BWAPI::Unit>            m_units;
+    std::vector<WorkerRole>             m_roles;
+    std::vector<int>                    m_rolePosition; // index of the worker in its role's list
+    std::vector<BWAPI::Unit>            m_resources;    // mineral patch or refinery, nullptr if none
+    std::vector<BWAPI::UnitType>        m_buildTypes;
+    std::vector<BWAPI::TilePosition>    m_buildTargets;
+
+    std::array<std::vector<BWAPI::Unit>, (size_t)WorkerRole::Count> m_byRole;
+
+    int     slot(BWAPI::Unit unit) const;
+    void    unlinkRole(int slot);
+    void    linkRole(int slot, WorkerRole role);
+
+public:
+
+    WorkerRegistry();
+
+    void    clear();
+
+    // false if the unit is already registered or its id is out of range
+    bool    add(BWAPI::Unit worker, WorkerRole role = WorkerRole::Idle);
+    bool    remove(BWAPI::Unit worker);
+    bool    contains(BWAPI::Unit worker) const;
+    size_t  size() const;
+
+    void    setRole(BWAPI::Unit worker, WorkerRole role);
+    void    setResource(BWAPI::Unit worker, BWAPI::Unit resource);
+    void    setBuildTarget(BWAPI::Unit worker, BWAPI::UnitType type, BWAPI::TilePosition tile);
+
+    WorkerRole          getRole(BWAPI::Unit worker) const;
+    BWAPI::Unit         getResource(BWAPI::Unit worker) const;
+    BWAPI::UnitType     getBuildType(BWAPI::Unit worker) const;
+    BWAPI::TilePosition getBuildTarget(BWAPI::Unit worker) const;
+
+    // all registered workers, in slot order
+    const std::vector<BWAPI::Unit> & getWorkers() const;
+
+    // the workers with a given role, in no particular order
+    const std::vector<BWAPI::Unit> & getWorkers(WorkerRole role) const;
+};
@@ -2,6 +2,7 @@
 #include <BWAPI/Client.h>
 #include "StarterBot.h"
 #include "ReplayParser.h"
+#include "Profiler.h"
 #include <iostream>
 #include <thread>
 #include <chrono>
@@ -77,7 +78,10 @@ void PlayGame()
             }
         }
 
-        BWAPI::BWAPIClient.update();
+        {
+            PROFILE_SCOPE("Client::update");
+            BWAPI::BWAPIClient.update();
+        }
         if (!BWAPI::BWAPIClient.isConnected())
         {
             std::cout << "Disconnected\n";